@@ -0,0 +1,941 @@
+/**
+ * Tests for vector.c: every container is checked against a naive reference, and every
+ * persistence format is round tripped (including damaged files, which must be refused).
+ *
+ * Build and run with "make test". "make bench" (or ./test_vector --bench) measures text import.
+ */
+
+#include "vector.c"
+
+#include <poll.h>
+#include <sys/time.h>
+
+
+//////////////////////////////////////////////////////
+//				  // TEST HARNESS //				//
+//////////////////////////////////////////////////////
+
+static int checks = 0;
+static int failures = 0;
+static char directory[] = "/tmp/test_vector.XXXXXX";
+
+// Records a check, printing where it failed (the test carries on, so one run reports every failure)
+#define CHECK(condition) do {													\
+	checks++;																	\
+	if (!(condition)) {															\
+		failures++;																\
+		fprintf(stderr, "FAILED: %s:%d: %s\n", __FILE__, __LINE__, #condition);	\
+	}																			\
+} while (0)
+
+/**
+ * A small deterministic pseudo random generator (xorshift), so failures reproduce.
+ *
+ * @return The next pseudo random number
+ */
+static unsigned long long next_random() {
+	static unsigned long long state = 0x9E3779B97F4A7C15ULL;
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+/**
+ * The path of a scratch file in the test directory.
+ *
+ * @param name The name of the file
+ * @return The path (in a static buffer, valid until the next call)
+ */
+static const char* scratch_path(const char *name) {
+	static char path[256];
+	snprintf(path, sizeof(path), "%s/%s", directory, name);
+	return path;
+}
+
+/**
+ * Compares two ints (as in sort_vector).
+ */
+static int compare_int(void *elem1, void *elem2) {
+	int a = *(int*) elem1;
+	int b = *(int*) elem2;
+	return (a > b) - (a < b);
+}
+
+/**
+ * Compares two long longs (as in sort_vector).
+ */
+static int compare_long(void *elem1, void *elem2) {
+	long long a = *(long long*) elem1;
+	long long b = *(long long*) elem2;
+	return (a > b) - (a < b);
+}
+
+/**
+ * qsort adapter for compare_int, used to build the naive references.
+ */
+static int qsort_int(const void *elem1, const void *elem2) {
+	return compare_int((void*) elem1, (void*) elem2);
+}
+
+/**
+ * Whether a vector holds exactly the given ints.
+ *
+ * @param vector The vector of ints
+ * @param expected The expected elements
+ * @param count The amount of expected elements
+ * @return Whether they match
+ */
+static BOOL vector_equals_ints(Vector *vector, int *expected, size_t count) {
+	return vector != NULL && vector->elem_size == sizeof(int) && vector->length == count
+			&& (count == 0 || memcmp(vector->array, expected, count * sizeof(int)) == 0);
+}
+
+/**
+ * Creates a vector of count pseudo random ints in [0, range).
+ *
+ * @param count The amount of ints
+ * @param range The bound of the values
+ * @return The vector
+ */
+static Vector* random_ints(size_t count, int range) {
+	Vector *vector = create_vector(sizeof(int));
+	for (size_t i = 0; i < count; i++) {
+		int value = next_random() % range;
+		push_back(vector, &value);
+	}
+	return vector;
+}
+
+
+//////////////////////////////////////////////////////
+//				 // CONTAINERS //					//
+//////////////////////////////////////////////////////
+
+static void test_sparse_vector() {
+	int zero = 0;
+	int reference[1000] = { 0 };
+	SparseVector *sparse = create_sparse_vector(sizeof(int), 1000, &zero);
+
+	for (int i = 0; i < 3000; i++) {
+		size_t index = next_random() % 1000;
+		int value = next_random() % 4; // Often the default, which must release the slot
+		sparse_set_elem(sparse, index, &value);
+		reference[index] = value;
+	}
+
+	size_t populated = 0;
+	for (int i = 0; i < 1000; i++) {
+		populated += reference[i] != 0;
+		CHECK(*(int*) sparse_get_elem(sparse, i) == reference[i]);
+	}
+	CHECK(sparse_populated_count(sparse) == populated);
+
+	Vector *dense = sparse_to_vector(sparse);
+	CHECK(vector_equals_ints(dense, reference, 1000));
+	free_vector(dense);
+	free_sparse_vector(sparse);
+}
+
+static void test_string_vector() {
+	StringVector *strings = create_string_vector();
+	const char *words[] = { "pear", "", "apple", "fig", "apple" };
+	for (int i = 0; i < 5; i++) {
+		string_push_back(strings, words[i], strlen(words[i]));
+	}
+
+	size_t length;
+	const char *word = string_get_elem(strings, 2, &length);
+	CHECK(length == 5 && memcmp(word, "apple", 5) == 0);
+	CHECK(string_index_of(strings, "fig", 3) == 3);
+	CHECK(string_index_of(strings, "kiwi", 4) == -1);
+
+	sort_string_vector(strings);
+	const char *sorted[] = { "", "apple", "apple", "fig", "pear" };
+	for (int i = 0; i < 5; i++) {
+		word = string_get_elem(strings, i, &length);
+		CHECK(length == strlen(sorted[i]) && memcmp(word, sorted[i], length) == 0);
+	}
+	free_string_vector(strings);
+}
+
+static void test_jagged_vector() {
+	JaggedVector *jagged = create_jagged_vector(sizeof(int), 50);
+	int counts[50] = { 0 };
+
+	// Rows are pushed to out of order, finalizing must still group them
+	for (int i = 0; i < 2000; i++) {
+		size_t row = next_random() % 50;
+		int value = (int) row * 10000 + counts[row]++;
+		jagged_row_push(jagged, row, &value);
+	}
+	finalize_jagged_vector(jagged);
+
+	for (size_t row = 0; row < 50; row++) {
+		size_t length;
+		int *elements = jagged_get_row(jagged, row, &length);
+		CHECK(length == (size_t) counts[row]);
+		for (size_t i = 0; i < length; i++) {
+			CHECK(elements[i] == (int) (row * 10000 + i));
+		}
+	}
+	free_jagged_vector(jagged);
+}
+
+static void test_matrix() {
+	size_t n = 70; // Not a multiple of MATRIX_BLOCK_SIZE, so the block edges are exercised
+	Vector *a = create_vector(sizeof(double));
+	Vector *b = create_vector(sizeof(double));
+	Vector *c = create_vector_with_capacity(sizeof(double), n * n);
+	double zero = 0;
+	for (size_t i = 0; i < n * n; i++) {
+		double x = (double) (next_random() % 100) / 10;
+		double y = (double) (next_random() % 100) / 10;
+		push_back(a, &x);
+		push_back(b, &y);
+		push_back(c, &zero);
+	}
+
+	MatrixView left = matrix_view(a, n, n);
+	MatrixView right = matrix_view(b, n, n);
+	MatrixView result = matrix_view(c, n, n);
+	matrix_multiply_double(left, right, result);
+
+	BOOL matches = TRUE;
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			double expected = 0;
+			for (size_t k = 0; k < n; k++) {
+				expected += *(double*) matrix_get_elem(left, i, k) * *(double*) matrix_get_elem(right, k, j);
+			}
+			matches = matches && fabs(expected - *(double*) matrix_get_elem(result, i, j)) < 1e-6;
+		}
+	}
+	CHECK(matches);
+
+	// A result overlapping an input is refused and left alone
+	double before = *(double*) get_elem(a, 0);
+	matrix_multiply_double(left, right, left);
+	CHECK(*(double*) get_elem(a, 0) == before);
+
+	// Out of place and in place transposes agree with the strided transpose view
+	matrix_transpose(left, result);
+	MatrixView flipped = matrix_transpose_view(left);
+	matches = TRUE;
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			matches = matches && *(double*) matrix_get_elem(result, i, j) == *(double*) matrix_get_elem(flipped, i, j);
+		}
+	}
+	matrix_transpose(result, result);
+	CHECK(matches && memcmp(c->array, a->array, n * n * sizeof(double)) == 0);
+
+	double sums[70];
+	matrix_row_sums_double(left, sums);
+	double expected = 0;
+	for (size_t j = 0; j < n; j++) {
+		expected += *(double*) matrix_get_elem(left, 3, j);
+	}
+	CHECK(fabs(sums[3] - expected) < 1e-9);
+
+	// Views larger than their vector are emptied
+	CHECK(matrix_view(a, n + 1, n).rows == 0);
+
+	free_vector(a);
+	free_vector(b);
+	free_vector(c);
+}
+
+static void test_flat_set_and_map() {
+	FlatSet *set = create_flat_set(sizeof(int), compare_int);
+	char present[1000] = { 0 };
+
+	for (int round = 0; round < 5; round++) {
+		Vector *batch = random_ints(300, 1000);
+		for (size_t i = 0; i < batch->length; i++) {
+			present[*(int*) get_elem(batch, i)] = 1;
+		}
+		flat_set_insert_bulk(set, batch);
+		free_vector(batch);
+
+		int value = next_random() % 1000;
+		flat_set_erase(set, &value);
+		present[value] = 0;
+	}
+
+	int reference[1000];
+	size_t count = 0;
+	for (int i = 0; i < 1000; i++) {
+		if (present[i]) {
+			reference[count++] = i;
+		}
+	}
+	CHECK(vector_equals_ints(set->elements, reference, count));
+	free_flat_set(set);
+
+	// 8 byte keys with 4 byte values: the bulk insert pads its records so keys stay aligned
+	FlatMap *map = create_flat_map(sizeof(long long), sizeof(int), compare_long);
+	int last_value[500];
+	memset(last_value, -1, sizeof(last_value));
+	Vector *keys = create_vector(sizeof(long long));
+	Vector *values = create_vector(sizeof(int));
+	for (int i = 0; i < 2000; i++) {
+		long long key = next_random() % 500;
+		push_back(keys, &key);
+		push_back(values, &i);
+		last_value[key] = i;
+	}
+	flat_map_insert_bulk(map, keys, values);
+
+	BOOL matches = TRUE;
+	for (long long key = 0; key < 500; key++) {
+		int *value = flat_map_find(map, &key);
+		matches = matches && (last_value[key] < 0 ? value == NULL : value != NULL && *value == last_value[key]);
+	}
+	CHECK(matches);
+
+	// Mismatched element sizes are refused
+	Vector *wrong = random_ints(values->length, 10);
+	CHECK(flat_map_insert_bulk(map, wrong, values) == 0);
+	free_vector(wrong);
+
+	free_vector(keys);
+	free_vector(values);
+	free_flat_map(map);
+}
+
+static void test_sorted_mode_and_merges() {
+	// Sorted mode: push_back inserts in order, merge_insert_sorted gallops batches in
+	Vector *sorted = create_vector(sizeof(int));
+	make_vector_sorted(sorted, compare_int);
+	int reference[6000];
+	size_t count = 0;
+
+	for (int i = 0; i < 1000; i++) {
+		int value = next_random() % 5000;
+		push_back(sorted, &value);
+		reference[count++] = value;
+	}
+	for (int round = 0; round < 5; round++) {
+		Vector *batch = random_ints(1000, 5000);
+		sort_vector(batch, compare_int);
+		merge_insert_sorted(sorted, batch, compare_int);
+		memcpy(reference + count, batch->array, 1000 * sizeof(int));
+		count += 1000;
+		free_vector(batch);
+	}
+	qsort(reference, count, sizeof(int), qsort_int);
+	CHECK(vector_equals_ints(sorted, reference, count));
+
+	// k-way merge against concatenating and sorting
+	Vector *runs[8];
+	count = 0;
+	for (int i = 0; i < 8; i++) {
+		runs[i] = random_ints(next_random() % 500, 1000);
+		sort_vector(runs[i], compare_int);
+		memcpy(reference + count, runs[i]->array, runs[i]->length * sizeof(int));
+		count += runs[i]->length;
+	}
+	qsort(reference, count, sizeof(int), qsort_int);
+	Vector *out = create_vector(sizeof(int));
+	CHECK(kway_merge(runs, 8, compare_int, FALSE, out) == count);
+	CHECK(vector_equals_ints(out, reference, count));
+
+	for (int i = 0; i < 8; i++) {
+		free_vector(runs[i]);
+	}
+	free_vector(out);
+	free_vector(sorted);
+}
+
+static void test_heap() {
+	for (int arity = 2; arity <= 4; arity += 2) {
+		Vector *heap = random_ints(500, 10000);
+		int reference[1000];
+		memcpy(reference, heap->array, 500 * sizeof(int));
+		heapify_dary(heap, arity, compare_int);
+
+		for (int i = 500; i < 1000; i++) {
+			reference[i] = next_random() % 10000;
+			heap_push_dary(heap, arity, &reference[i], compare_int);
+		}
+		qsort(reference, 1000, sizeof(int), qsort_int);
+
+		BOOL matches = TRUE;
+		int popped;
+		for (int i = 0; i < 1000; i++) {
+			matches = matches && heap_pop_dary(heap, arity, &popped, compare_int) && popped == reference[i];
+		}
+		CHECK(matches);
+		CHECK(!heap_pop_dary(heap, arity, &popped, compare_int));
+		free_vector(heap);
+	}
+}
+
+/**
+ * btree_for_each visitor appending each element to a vector.
+ */
+static void collect_element(void *element, void *context) {
+	push_back(context, element);
+}
+
+static void test_btree() {
+	// Enough elements (with duplicates) to split leaves and internal nodes several levels deep
+	BTree *tree = create_btree(sizeof(int), compare_int);
+	Vector *reference = create_vector(sizeof(int));
+	for (int i = 0; i < 50000; i++) {
+		int value = next_random() % 20000;
+		btree_insert(tree, &value);
+		push_back(reference, &value);
+	}
+
+	// Erase a third of them, some of which are not present any more
+	for (int i = 0; i < 20000; i++) {
+		int value = next_random() % 20000;
+		int index = index_of(reference, &value);
+		CHECK(btree_erase(tree, &value) == (index >= 0));
+		if (index >= 0) {
+			remove_elem(reference, index);
+		}
+	}
+	qsort(reference->array, reference->length, sizeof(int), qsort_int);
+
+	Vector *contents = create_vector(sizeof(int));
+	btree_for_each(tree, collect_element, contents);
+	CHECK(vector_equals_ints(contents, reference->array, reference->length));
+
+	int missing = 20000;
+	CHECK(btree_find(tree, &missing) == NULL);
+
+	free_vector(contents);
+	free_vector(reference);
+	free_btree(tree);
+}
+
+static void test_slot_map_and_intern() {
+	SlotMap *map = create_slot_map(sizeof(int));
+	SlotHandle handles[100];
+	for (int i = 0; i < 100; i++) {
+		handles[i] = slot_map_insert(map, &i);
+	}
+	for (int i = 0; i < 100; i += 3) {
+		CHECK(slot_map_remove(map, handles[i]));
+	}
+	for (int i = 0; i < 100; i++) {
+		int *value = slot_map_get(map, handles[i]);
+		CHECK(i % 3 == 0 ? value == NULL : value != NULL && *value == i);
+	}
+
+	// Reused slots get a new generation, so the old handles stay stale
+	int reused = 1000;
+	SlotHandle fresh = slot_map_insert(map, &reused);
+	CHECK(*(int*) slot_map_get(map, fresh) == 1000);
+	CHECK(slot_map_get(map, handles[98]) != NULL && !slot_map_remove(map, handles[0]));
+	free_slot_map(map);
+
+	InternVector *interned = create_intern_vector(sizeof(int));
+	int first_index[100];
+	memset(first_index, -1, sizeof(first_index));
+	for (int i = 0; i < 1000; i++) {
+		int value = next_random() % 100;
+		int index = intern(interned, &value);
+		CHECK(first_index[value] < 0 || first_index[value] == index);
+		first_index[value] = index;
+	}
+	int absent = 100;
+	CHECK(intern_index_of(interned, &absent) == -1);
+	free_intern_vector(interned);
+}
+
+static void test_attached_indexes() {
+	Vector *vector = random_ints(5000, 1000);
+	attach_range_index(vector, NUMERIC_INT);
+	attach_zone_map(vector, NUMERIC_INT, 64);
+	attach_bloom_filter(vector);
+
+	// Mutate through several paths, then compare every index with a scan
+	for (int i = 0; i < 2000; i++) {
+		int value = next_random() % 1000;
+		int index = next_random() % vector->length;
+		switch (i % 3) {
+			case 0:
+				set_elem(vector, index, &value);
+				break;
+			case 1:
+				push_back(vector, &value);
+				break;
+			default:
+				remove_elem(vector, index);
+		}
+	}
+
+	int *elements = vector->array;
+	BOOL matches = TRUE;
+	for (int trial = 0; trial < 200; trial++) {
+		size_t from = next_random() % vector->length;
+		size_t to = from + next_random() % (vector->length - from + 1);
+		long long sum = 0;
+		double minimum = INFINITY;
+		double maximum = -INFINITY;
+		for (size_t i = from; i < to; i++) {
+			sum += elements[i];
+			minimum = fmin(minimum, elements[i]);
+			maximum = fmax(maximum, elements[i]);
+		}
+		matches = matches && range_sum_integer(vector, from, to) == sum
+				&& range_min(vector, from, to) == minimum && range_max(vector, from, to) == maximum;
+	}
+	CHECK(matches);
+
+	Vector *filtered = filter_range(vector, 100, 200);
+	size_t expected = 0;
+	for (size_t i = 0; i < vector->length; i++) {
+		expected += elements[i] >= 100 && elements[i] <= 200;
+	}
+	CHECK(filtered != NULL && filtered->length == expected);
+	free_vector(filtered);
+
+	matches = TRUE;
+	for (size_t i = 0; i < vector->length; i++) {
+		matches = matches && bloom_filter_may_contain(vector, &elements[i]);
+	}
+	CHECK(matches);
+	free_vector(vector);
+}
+
+
+//////////////////////////////////////////////////////
+//				 // PERSISTENCE //					//
+//////////////////////////////////////////////////////
+
+static void test_save_and_load() {
+	Vector *vector = random_ints(100000, 1 << 30);
+	CHECK(vector_save(vector, scratch_path("saved")));
+
+	Vector *loaded = vector_load(scratch_path("saved"));
+	CHECK(vector_equals_ints(loaded, vector->array, vector->length));
+	free_vector(loaded);
+
+	// Cut short, the file is refused rather than half loaded
+	CHECK(truncate(scratch_path("saved"), VECTOR_FILE_HEADER_SIZE + 1000) == 0);
+	CHECK(vector_load(scratch_path("saved")) == NULL);
+
+	// Round trip through a pipe, which has no size to check against
+	int pipe_fds[2];
+	CHECK(pipe(pipe_fds) == 0);
+	Vector *small = random_ints(1000, 100);
+	CHECK(vector_write_fd(small, pipe_fds[1]));
+	close(pipe_fds[1]);
+	loaded = vector_read_fd(pipe_fds[0]);
+	close(pipe_fds[0]);
+	CHECK(vector_equals_ints(loaded, small->array, small->length));
+
+	free_vector(loaded);
+	free_vector(small);
+	free_vector(vector);
+}
+
+static void test_mapped_vectors() {
+	const char *path = scratch_path("mapped");
+	Vector *mapped = create_mapped_vector(path, sizeof(int), 0);
+	Vector *reference = random_ints(50000, 1000); // Enough to remap a few times
+	for (size_t i = 0; i < reference->length; i++) {
+		push_back(mapped, get_elem(reference, i));
+	}
+	CHECK(sync_vector(mapped));
+	free_vector(mapped);
+
+	Vector *reopened = open_mapped_vector(path);
+	CHECK(vector_equals_ints(reopened, reference->array, reference->length));
+	free_vector(reopened);
+
+	// Read only: usable in place, every modification refused
+	Vector *readonly = open_readonly_vector(path);
+	CHECK(vector_equals_ints(readonly, reference->array, reference->length));
+	int value = -1;
+	push_back(readonly, &value);
+	set_elem(readonly, 0, &value);
+	CHECK(vector_equals_ints(readonly, reference->array, reference->length));
+	free_vector(readonly);
+	free_vector(reference);
+}
+
+/**
+ * vector_stream_consume callback appending each chunk to a Vector*.
+ */
+static void consume_chunk(void *elements, size_t count, size_t elem_size, void *context) {
+	Vector *out = context;
+	for (size_t i = 0; i < count; i++) {
+		push_back(out, elements + i * elem_size);
+	}
+}
+
+static void test_streams() {
+	Vector *vector = random_ints(3 * VECTOR_STREAM_CHUNK / sizeof(int) + 7, 1000); // Several chunks, one partial
+	FILE *file = tmpfile();
+	int fd = fileno(file);
+
+	CHECK(vector_stream_write(vector, fd));
+	lseek(fd, 0, SEEK_SET);
+	Vector *read = vector_stream_read(fd);
+	CHECK(vector_equals_ints(read, vector->array, vector->length));
+	free_vector(read);
+
+	lseek(fd, 0, SEEK_SET);
+	Vector *consumed = create_vector(sizeof(int));
+	CHECK(vector_stream_consume(fd, consume_chunk, consumed) == sizeof(int));
+	CHECK(vector_equals_ints(consumed, vector->array, vector->length));
+	free_vector(consumed);
+
+	// A corrupted chunk fails its checksum
+	off_t middle = lseek(fd, 0, SEEK_END) / 2;
+	char junk = 0x5A;
+	CHECK(pwrite(fd, &junk, 1, middle) == 1);
+	lseek(fd, 0, SEEK_SET);
+	CHECK(vector_stream_read(fd) == NULL);
+
+	fclose(file);
+	free_vector(vector);
+}
+
+static void test_async_io() {
+	Vector *vector = random_ints(3 * VECTOR_ASYNC_CHUNK / sizeof(int) + 5, 1 << 30); // Split between threads
+	const char *path = scratch_path("async");
+
+	for (int direct = 0; direct <= 1; direct++) {
+		VectorIORequest *request = vector_save_async(vector, path, direct, NULL, NULL);
+		CHECK(request != NULL);
+		if (request == NULL) {
+			continue;
+		}
+		struct pollfd finished = { vector_io_fd(request), POLLIN, 0 };
+		CHECK(poll(&finished, 1, -1) == 1);
+		CHECK(vector_io_done(request) && vector_io_wait(request));
+		free_vector_io(request);
+
+		request = vector_load_async(path, direct, NULL, NULL);
+		CHECK(request != NULL);
+		if (request != NULL) {
+			Vector *loaded = vector_io_take(request);
+			CHECK(vector_equals_ints(loaded, vector->array, vector->length));
+			free_vector(loaded);
+			free_vector_io(request);
+		}
+	}
+
+	// A truncated file fails the load instead of hanging or half loading
+	CHECK(truncate(path, VECTOR_FILE_HEADER_SIZE + 4096) == 0);
+	VectorIORequest *request = vector_load_async(path, FALSE, NULL, NULL);
+	CHECK(request != NULL && !vector_io_wait(request) && vector_io_take(request) == NULL);
+	if (request != NULL) {
+		free_vector_io(request);
+	}
+	free_vector(vector);
+}
+
+static void test_shared_vector() {
+	Vector *shared = create_shared_vector(NULL, sizeof(int), 10000, TRUE);
+	CHECK(shared != NULL);
+	if (shared == NULL) {
+		return;
+	}
+
+	// Children push through their own view of the segment under the shared lock
+	fflush(NULL);
+	for (int child = 0; child < 4; child++) {
+		if (fork() == 0) {
+			Vector *view = open_shared_vector_fd(dup(shared_vector_fd(shared)), FALSE);
+			for (int i = 0; i < 1000; i++) {
+				lock_shared_vector(view, TRUE);
+				push_back(view, &i);
+				unlock_shared_vector(view);
+			}
+			_exit(0);
+		}
+	}
+	while (wait(NULL) > 0);
+
+	lock_shared_vector(shared, FALSE);
+	long long sum = 0;
+	for (size_t i = 0; i < shared->length; i++) {
+		sum += *(int*) get_elem(shared, i);
+	}
+	CHECK(shared->length == 4000 && sum == 4LL * 999 * 1000 / 2);
+	unlock_shared_vector(shared);
+	free_vector(shared);
+}
+
+static void test_background_save() {
+	Vector *first = random_ints(200000, 1000);
+	Vector *second = random_ints(10, 1000);
+	Vector *expected = clone(first);
+	Vector *vectors[] = { first, second };
+
+	BackgroundSave *save = vector_save_background(vectors, 2, scratch_path("snapshot"));
+	CHECK(save != NULL);
+	if (save == NULL) {
+		return;
+	}
+
+	// Changes after the fork must not reach the snapshot
+	int value = -1;
+	for (int i = 0; i < 1000; i++) {
+		set_elem(first, i, &value);
+	}
+	CHECK(background_save_wait(save));
+	free_background_save(save);
+
+	Vector *loaded[2];
+	CHECK(vector_load_snapshot(scratch_path("snapshot"), loaded, 2));
+	CHECK(vector_equals_ints(loaded[0], expected->array, expected->length));
+	CHECK(vector_equals_ints(loaded[1], second->array, second->length));
+
+	free_vector(loaded[0]);
+	free_vector(loaded[1]);
+	free_vector(expected);
+	free_vector(first);
+	free_vector(second);
+}
+
+static void test_deltas() {
+	const char *base_path = strdup(scratch_path("base"));
+	const char *delta_paths[] = { strdup(scratch_path("delta1")), strdup(scratch_path("delta2")) };
+
+	Vector *vector = random_ints(100000, 1000);
+	CHECK(vector_save(vector, base_path));
+	attach_dirty_map(vector);
+
+	for (int delta = 0; delta < 2; delta++) {
+		for (int i = 0; i < 50; i++) {
+			int value = -(int) (next_random() % 1000);
+			set_elem(vector, next_random() % vector->length, &value);
+		}
+		int value = 7;
+		push_back(vector, &value);
+		CHECK(dirty_block_count(vector) > 0);
+		CHECK(vector_save_delta(vector, delta_paths[delta]));
+		CHECK(dirty_block_count(vector) == 0);
+	}
+
+	CHECK(compact_vector_deltas(base_path, delta_paths, 2));
+	Vector *compacted = vector_load(base_path);
+	CHECK(vector_equals_ints(compacted, vector->array, vector->length));
+
+	free_vector(compacted);
+	free_vector(vector);
+	free((char*) base_path);
+	free((char*) delta_paths[0]);
+	free((char*) delta_paths[1]);
+}
+
+static void test_journal() {
+	char *base_path = strdup(scratch_path("journal.base"));
+	char *log_path = strdup(scratch_path("journal.log"));
+	int reference[2000];
+	size_t count = 0;
+
+	JournaledVector *journaled = open_journaled_vector(base_path, log_path, sizeof(int), 0, 0);
+	CHECK(journaled != NULL);
+	if (journaled == NULL) {
+		return;
+	}
+	for (int i = 0; i < 1000; i++) {
+		int value = next_random() % 1000;
+		journal_push_back(journaled, &value);
+		reference[count++] = value;
+	}
+	int value = 5;
+	journal_set_elem(journaled, 10, &value);
+	reference[10] = value;
+	journal_remove_elem(journaled, 0);
+	memmove(reference, reference + 1, --count * sizeof(int));
+	CHECK(journal_commit(journaled));
+
+	// A checkpoint in the middle: the replay is base plus the records logged after it
+	CHECK(journal_checkpoint(journaled));
+	for (int i = 0; i < 100; i++) {
+		value = i;
+		journal_push_back(journaled, &value);
+		reference[count++] = value;
+	}
+	free_journaled_vector(journaled);
+
+	journaled = open_journaled_vector(base_path, log_path, sizeof(int), 0, 0);
+	CHECK(journaled != NULL && vector_equals_ints(journaled->vector, reference, count));
+
+	// A torn last group (a crash mid write) is dropped; everything committed before it survives
+	size_t committed = count;
+	for (int i = 0; i < 100; i++) {
+		value = -i;
+		journal_push_back(journaled, &value);
+	}
+	free_journaled_vector(journaled);
+
+	struct stat status;
+	CHECK(stat(log_path, &status) == 0 && truncate(log_path, status.st_size - 3) == 0);
+	journaled = open_journaled_vector(base_path, log_path, sizeof(int), 0, 0);
+	CHECK(journaled != NULL && journaled->vector->length >= committed && journaled->vector->length < committed + 100);
+	if (journaled != NULL) {
+		CHECK(memcmp(journaled->vector->array, reference, committed * sizeof(int)) == 0);
+
+		// Logging carries on cleanly after the dropped tail
+		size_t length = journaled->vector->length;
+		value = 42;
+		journal_push_back(journaled, &value);
+		free_journaled_vector(journaled);
+		journaled = open_journaled_vector(base_path, log_path, sizeof(int), 0, 0);
+		CHECK(journaled != NULL && journaled->vector->length == length + 1
+				&& *(int*) get_elem(journaled->vector, length) == 42);
+		if (journaled != NULL) {
+			free_journaled_vector(journaled);
+		}
+	}
+
+	free(base_path);
+	free(log_path);
+}
+
+static void test_text_import() {
+	const char *text = "1, 2,3\n-4 5\t6,\n2147483647\n";
+	int expected[] = { 1, 2, 3, -4, 5, 6, 2147483647 };
+	Vector *vector = create_vector(sizeof(int));
+	CHECK(vector_parse_text(vector, text, strlen(text), NUMERIC_INT, 4));
+	CHECK(vector_equals_ints(vector, expected, 7));
+
+	// Invalid or out of range numbers append nothing
+	CHECK(!vector_parse_text(vector, "7 x8 9", 6, NUMERIC_INT, 1));
+	CHECK(!vector_parse_text(vector, "2147483648", 10, NUMERIC_INT, 1));
+	CHECK(vector->length == 7);
+	free_vector(vector);
+
+	// Doubles must match strtod exactly, over enough text to split between threads
+	size_t count = 400000;
+	char *buffer = malloc(count * 32);
+	size_t length = 0;
+	double *reference = malloc(count * sizeof(double));
+	for (size_t i = 0; i < count; i++) {
+		int written = 0;
+		switch (i % 4) {
+			case 0:
+				written = sprintf(buffer + length, "%.17g", (double) next_random() / (double) (next_random() | 1));
+				break;
+			case 1:
+				written = sprintf(buffer + length, "%lld.%03d", (long long) (next_random() % 100000) - 50000,
+						(int) (next_random() % 1000));
+				break;
+			case 2:
+				written = sprintf(buffer + length, "%de%d", (int) (next_random() % 1000), (int) (next_random() % 600) - 300);
+				break;
+			default:
+				written = sprintf(buffer + length, "%d", (int) (next_random() % 2000000) - 1000000);
+		}
+		reference[i] = strtod(buffer + length, NULL);
+		length += written;
+		buffer[length++] = i % 10 == 9 ? '\n' : ',';
+	}
+
+	Vector *doubles = create_vector(sizeof(double));
+	CHECK(vector_parse_text(doubles, buffer, length, NUMERIC_DOUBLE, 4));
+	CHECK(doubles->length == count && memcmp(doubles->array, reference, count * sizeof(double)) == 0);
+
+	// And through a file
+	FILE *file = fopen(scratch_path("numbers.csv"), "w");
+	fwrite(buffer, 1, length, file);
+	fclose(file);
+	Vector *imported = create_vector(sizeof(double));
+	CHECK(vector_import_text(imported, scratch_path("numbers.csv"), NUMERIC_DOUBLE, 2));
+	CHECK(imported->length == count && memcmp(imported->array, reference, count * sizeof(double)) == 0);
+
+	free_vector(imported);
+	free_vector(doubles);
+	free(reference);
+	free(buffer);
+}
+
+
+//////////////////////////////////////////////////////
+//				  // BENCHMARKS //					//
+//////////////////////////////////////////////////////
+
+/**
+ * The wall clock time in seconds.
+ */
+static double seconds() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec / 1e6;
+}
+
+/**
+ * Measures vector_parse_text throughput on one thread, for integers and for mixed format doubles.
+ */
+static void bench_text_import() {
+	size_t count = 20000000;
+	char *buffer = malloc(count * 24);
+
+	for (int doubles = 0; doubles <= 1; doubles++) {
+		size_t length = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (!doubles) {
+				length += sprintf(buffer + length, "%d", (int) (next_random() % 2000000000) - 1000000000);
+			} else if (i % 2 == 0) {
+				length += sprintf(buffer + length, "%.6f", (double) (next_random() % 100000000) / 997);
+			} else {
+				length += sprintf(buffer + length, "%.3e", (double) (next_random() % 100000000) / 13);
+			}
+			buffer[length++] = i % 8 == 7 ? '\n' : ',';
+		}
+
+		Vector *vector = create_vector(doubles ? sizeof(double) : sizeof(long long));
+		double start = seconds();
+		BOOL parsed = vector_parse_text(vector, buffer, length, doubles ? NUMERIC_DOUBLE : NUMERIC_LONG, 1);
+		double elapsed = seconds() - start;
+
+		printf("vector_parse_text (1 thread, %s): %s, %.0f MB/s\n", doubles ? "mixed format doubles" : "integers",
+				parsed ? "ok" : "FAILED", length / elapsed / 1e6);
+		free_vector(vector);
+	}
+	free(buffer);
+}
+
+
+int main(int argc, char **argv) {
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		bench_text_import();
+		return 0;
+	}
+
+	if (mkdtemp(directory) == NULL) {
+		fprintf(stderr, "Failed to create a scratch directory: %s\n", strerror(errno));
+		return 1;
+	}
+
+	test_sparse_vector();
+	test_string_vector();
+	test_jagged_vector();
+	test_matrix();
+	test_flat_set_and_map();
+	test_sorted_mode_and_merges();
+	test_heap();
+	test_btree();
+	test_slot_map_and_intern();
+	test_attached_indexes();
+	test_save_and_load();
+	test_mapped_vectors();
+	test_streams();
+	test_async_io();
+	test_shared_vector();
+	test_background_save();
+	test_deltas();
+	test_journal();
+	test_text_import();
+
+	char command[64 + sizeof(directory)];
+	snprintf(command, sizeof(command), "rm -rf '%s'", directory);
+	if (system(command) != 0) {
+		fprintf(stderr, "Failed to remove %s\n", directory);
+	}
+
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures == 0 ? 0 : 1;
+}
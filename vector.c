@@ -14,11 +14,29 @@
  *
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <assert.h>
 #include <math.h>
+#include <time.h>
+#include <limits.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+
+// _GNU_SOURCE makes sched.h declare clone(2), which would clash with clone() below
+#define clone sched_clone
+#include <pthread.h>
+#undef clone
 
 
 //////////////////////////////////////////////////////
@@ -27,6 +45,32 @@
 #define TRUE 					1					//
 #define FALSE 					0					//
 #define BOOL 					int					//
+#define MATRIX_BLOCK_SIZE		64					//
+#define BTREE_LEAF_SIZE			128					//
+#define BTREE_FANOUT			64					//
+#define SLOT_MAP_NONE			((unsigned int) -1)	//
+#define ZONE_MAP_BLOCK_SIZE		4096				//
+#define BLOOM_BITS_PER_ELEM		10					//
+#define BLOOM_HASHES			7					//
+#define VECTOR_FILE_MAGIC		"CVECTOR"			//
+#define VECTOR_FILE_VERSION		1					//
+#define VECTOR_FILE_HEADER_SIZE	4096				//
+#define VECTOR_IO_CHUNK			(1 << 30)			//
+#define VECTOR_STREAM_MAGIC		"CVSTREAM"			//
+#define VECTOR_STREAM_CHUNK		(1 << 20)			//
+#define VECTOR_STREAM_MAX_CHUNK	(1 << 28)			//
+#define VECTOR_ASYNC_CHUNK		(1 << 24)			//
+#define VECTOR_ASYNC_THREADS	4					//
+#define VECTOR_DIRECT_ALIGN		4096				//
+#define DIRTY_BLOCK_SIZE		4096				//
+#define VECTOR_DELTA_MAGIC		"CVDELTA"			//
+#define VECTOR_JOURNAL_MAGIC	"CVJOURN"			//
+#define TEXT_IMPORT_MIN_CHUNK	(1 << 20)			//
+#define TEXT_IMPORT_MAX_THREADS	64					//
+#define SHARED_VECTOR_OPEN_WAIT	1000				// Milliseconds to wait for a shared vector being created
+#define MAX_ALIGN				_Alignof(max_align_t)		//
+#define MIN(a, b)				((a) < (b) ? (a) : (b))		//
+#define MAX(a, b)				((a) > (b) ? (a) : (b))		//
 //////////////////////////////////////////////////////
 
 
@@ -37,14 +81,624 @@
  * @param elem_size The size (in bytes) of each element
  * @param length The amount of elements currently stored in the array (Default: 0)
  * @param capacity How many elements the Vector is currently able to hold
+ * @param sorted_by The comparator the Vector is kept sorted by, or NULL if unordered (Default: NULL)
+ * @param *range_index The attached range query index, or NULL (Default: NULL)
+ * @param *zone_map The attached per block min/max summary, or NULL (Default: NULL)
+ * @param *bloom The attached Bloom filter over the elements, or NULL (Default: NULL)
+ * @param *dirty The attached dirty block tracking for incremental saves, or NULL (Default: NULL)
+ * @param *mapping The file array lives in, if it is memory mapped, or NULL (Default: NULL)
  */
 typedef struct Vector {
 	void *array;
 	size_t elem_size;
 	size_t length;
 	size_t capacity;
+	int (*sorted_by)(void *elem1, void *elem2);
+	struct RangeIndex *range_index;
+	struct ZoneMap *zone_map;
+	struct BloomFilter *bloom;
+	struct DirtyMap *dirty;
+	struct MappedFile *mapping;
 } Vector;
 
+/**
+ * The element types numeric Vector features know how to read.
+ */
+typedef enum NumericType {
+	NUMERIC_INT,
+	NUMERIC_LONG,
+	NUMERIC_FLOAT,
+	NUMERIC_DOUBLE
+} NumericType;
+
+/**
+ * RangeIndex struct.
+ * Range sum, minimum and maximum indexes over a numeric Vector, kept up to date as it changes.
+ * Sums are a Fenwick tree, minimums and maximums bottom up segment trees, all over size slots
+ * where slots past the end of the Vector hold the identity (0, +inf, -inf).
+ * Integer types are summed in (wrapping) 64 bit integers so incremental updates stay exact.
+ *
+ * @param type The type of the Vector's elements
+ * @param size The amount of slots (a power of 2 >= length)
+ * @param length The vector length the index currently reflects
+ * @param *sums The Fenwick tree of float and double types (1-based, size + 1 doubles), or NULL
+ * @param *integer_sums The Fenwick tree of integer types (1-based, size + 1 words), or NULL
+ * @param *minimums The minimum segment tree (leaves at [size, 2 * size))
+ * @param *maximums The maximum segment tree (leaves at [size, 2 * size))
+ */
+typedef struct RangeIndex {
+	NumericType type;
+	size_t size;
+	size_t length;
+	double *sums;
+	unsigned long long *integer_sums;
+	double *minimums;
+	double *maximums;
+} RangeIndex;
+
+/**
+ * Zone struct.
+ * The summary of one block of a zone mapped Vector.
+ *
+ * @param min The smallest element of the block (may be looser after set_elem)
+ * @param max The largest element of the block (may be looser after set_elem)
+ * @param count The amount of elements in the block
+ */
+typedef struct Zone {
+	double min;
+	double max;
+	size_t count;
+} Zone;
+
+/**
+ * ZoneMap struct.
+ * Min/max summaries of each fixed size block of a numeric Vector, so searches for values
+ * can skip every block whose [min, max] cannot contain them.
+ *
+ * @param type The type of the Vector's elements
+ * @param block_size The amount of elements summarised by each zone
+ * @param length The vector length the zone map currently reflects
+ * @param *zones A Vector of Zone, one per block
+ */
+typedef struct ZoneMap {
+	NumericType type;
+	size_t block_size;
+	size_t length;
+	Vector *zones;
+} ZoneMap;
+
+/**
+ * BloomFilter struct.
+ * A blocked Bloom filter over the elements of a Vector: every element sets BLOOM_HASHES bits
+ * within a single 512 bit (cache line) block. Bits are never cleared, so removed or overwritten
+ * elements linger as false positives until the filter is rebuilt.
+ *
+ * @param *bits The filter, block_count blocks of 8 words each
+ * @param block_count The amount of 512 bit blocks
+ * @param capacity The amount of elements the filter was sized for
+ * @param inserted The amount of elements added since the last rebuild
+ * @param stale The amount of elements removed or overwritten since the last rebuild
+ * @param length The vector length the filter currently reflects
+ */
+typedef struct BloomFilter {
+	unsigned long long *bits;
+	size_t block_count;
+	size_t capacity;
+	size_t inserted;
+	size_t stale;
+	size_t length;
+} BloomFilter;
+
+/**
+ * InternVector struct.
+ * A Vector which never stores the same element twice, with an open addressing hash table
+ * (linear probing) over the element bytes mapping each element to its index.
+ *
+ * @param *elements A Vector holding each distinct element once, in first seen order
+ * @param *table A Vector of unsigned int holding index + 1 of an element per slot, or 0 if empty
+ */
+typedef struct InternVector {
+	Vector *elements;
+	Vector *table;
+} InternVector;
+
+/**
+ * VectorFileHeader struct.
+ * The header at the start of a saved Vector file, padded out to VECTOR_FILE_HEADER_SIZE bytes
+ * so the raw array which follows it starts page aligned.
+ *
+ * @param magic Always VECTOR_FILE_MAGIC
+ * @param version The file format version (VECTOR_FILE_VERSION)
+ * @param endianness 0x01020304 as written by the saving machine
+ * @param elem_size The size (in bytes) of each element
+ * @param length The amount of elements in the file
+ * @param capacity The amount of elements the file has room for (>= length)
+ * @param checksum hash_bytes of the length * elem_size bytes of data, or 0 if not computed
+ */
+typedef struct VectorFileHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int endianness;
+	unsigned long long elem_size;
+	unsigned long long length;
+	unsigned long long capacity;
+	unsigned long long checksum;
+} VectorFileHeader;
+
+/**
+ * MappedFile struct.
+ * A vector file mapped into memory, header and all, backing a Vector's array.
+ *
+ * @param fd The open file descriptor of the file
+ * @param *base The start of the mapping (the VectorFileHeader)
+ * @param bytes The size of the mapping
+ * @param read_only Whether the mapping is read only (every mutating call on the vector is refused)
+ * @param shared Whether it is a shared memory segment (see create_shared_vector), which never remaps
+ */
+typedef struct MappedFile {
+	int fd;
+	void *base;
+	size_t bytes;
+	BOOL read_only;
+	BOOL shared;
+} MappedFile;
+
+/**
+ * SharedVectorHeader struct.
+ * The header page of a shared memory vector: the usual VectorFileHeader, followed by
+ * the process shared lock guarding the vector.
+ *
+ * @param file The VectorFileHeader (length and capacity are kept up to date in it)
+ * @param locked Whether lock was initialised (the vector was created with locking)
+ * @param lock The process shared reader / writer lock
+ * @param ready Set (with a release store) once the segment is fully sized and initialised
+ */
+typedef struct SharedVectorHeader {
+	VectorFileHeader file;
+	int locked;
+	pthread_rwlock_t lock;
+	int ready;
+} SharedVectorHeader;
+
+/**
+ * BackgroundSave struct.
+ * A snapshot being written by a forked child process (see vector_save_background).
+ *
+ * @param pid The process id of the child
+ * @param status_fd The read end of a pipe only the child holds open, which polls readable once it exits
+ * @param done Whether the child has exited (and been reaped)
+ * @param ok Whether the child wrote the snapshot successfully, once done
+ */
+typedef struct BackgroundSave {
+	pid_t pid;
+	int status_fd;
+	BOOL done;
+	BOOL ok;
+} BackgroundSave;
+
+/**
+ * DirtyMap struct.
+ * A bitmap of the blocks of a Vector changed since it was last saved, one bit per
+ * block of DIRTY_BLOCK_SIZE bytes worth of elements.
+ *
+ * @param *bits The bitmap, a bit per block
+ * @param block_count The amount of blocks the bitmap has room for
+ * @param block_elems The amount of elements per block
+ */
+typedef struct DirtyMap {
+	unsigned long long *bits;
+	size_t block_count;
+	size_t block_elems;
+} DirtyMap;
+
+/**
+ * VectorDeltaHeader struct.
+ * Starts a delta file (see vector_save_delta), which is followed by block_count blocks,
+ * each a DeltaBlockHeader and the block's elements.
+ *
+ * @param magic Always VECTOR_DELTA_MAGIC
+ * @param version The file format version (VECTOR_FILE_VERSION)
+ * @param endianness 0x01020304 as written by the saving machine
+ * @param elem_size The size (in bytes) of each element
+ * @param length The length of the vector when the delta was saved
+ * @param block_elems The amount of elements per block
+ * @param block_count The amount of blocks in the file
+ */
+typedef struct VectorDeltaHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int endianness;
+	unsigned long long elem_size;
+	unsigned long long length;
+	unsigned long long block_elems;
+	unsigned long long block_count;
+} VectorDeltaHeader;
+
+/**
+ * DeltaBlockHeader struct.
+ * Precedes the elements of each block in a delta file (the last block of the vector may be short).
+ *
+ * @param block The index of the block
+ * @param checksum hash_bytes of the block's elements
+ */
+typedef struct DeltaBlockHeader {
+	unsigned long long block;
+	unsigned long long checksum;
+} DeltaBlockHeader;
+
+/**
+ * The operations a JournaledVector records.
+ */
+typedef enum JournalOp {
+	JOURNAL_PUSH_BACK = 1,
+	JOURNAL_SET_ELEM,
+	JOURNAL_REMOVE_ELEM,
+	JOURNAL_SWAP_ELEMS,
+	JOURNAL_SET_RANGE,
+	JOURNAL_REMOVE_RANGE
+} JournalOp;
+
+/**
+ * JournalHeader struct.
+ * Starts a journal log, naming the base snapshot the log's records apply on top of,
+ * so a log left over from before a checkpoint is recognised and discarded.
+ *
+ * @param magic Always VECTOR_JOURNAL_MAGIC
+ * @param version The file format version (VECTOR_FILE_VERSION)
+ * @param endianness 0x01020304 as written by the logging machine
+ * @param elem_size The size (in bytes) of each element
+ * @param base_length The length of the base snapshot
+ * @param base_checksum hash_bytes of the base snapshot's elements
+ */
+typedef struct JournalHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int endianness;
+	unsigned long long elem_size;
+	unsigned long long base_length;
+	unsigned long long base_checksum;
+} JournalHeader;
+
+/**
+ * JournalRecord struct.
+ * One operation in a journal log, followed by its elements (one for JOURNAL_PUSH_BACK and
+ * JOURNAL_SET_ELEM, second for JOURNAL_SET_RANGE, none otherwise).
+ *
+ * @param op The JournalOp
+ * @param first The index operated on (the first index, for swaps and ranges)
+ * @param second The second index for swaps, the end of the range for JOURNAL_REMOVE_RANGE,
+ *               the amount of elements for JOURNAL_SET_RANGE, otherwise 0
+ * @param checksum hash_bytes of the record (with checksum 0) mixed with that of its elements
+ */
+typedef struct JournalRecord {
+	unsigned long long op;
+	unsigned long long first;
+	unsigned long long second;
+	unsigned long long checksum;
+} JournalRecord;
+
+/**
+ * JournaledVector struct.
+ * A Vector made durable by a base snapshot plus an append only log of every operation since.
+ * Operations are applied straight away and logged in groups: each group is written with a
+ * single write and made durable with a single fdatasync (group commit).
+ *
+ * @param *vector The vector itself (read it freely, but only modify it through journal_ functions)
+ * @param *base_path The path of the base snapshot (a vector_save file)
+ * @param *log_path The path of the log
+ * @param log_fd The open file descriptor of the log
+ * @param *pending The bytes of the records not yet written to the log (a Vector of chars)
+ * @param pending_records The amount of records in pending
+ * @param commit_every The amount of records per group commit (0 to commit only when asked)
+ * @param checkpoint_bytes The log size to roll the log into the base snapshot at (0 to never)
+ * @param log_bytes The size of the log
+ */
+typedef struct JournaledVector {
+	Vector *vector;
+	char *base_path;
+	char *log_path;
+	int log_fd;
+	Vector *pending;
+	size_t pending_records;
+	size_t commit_every;
+	size_t checkpoint_bytes;
+	size_t log_bytes;
+} JournaledVector;
+
+/**
+ * TextImportChunk struct.
+ * The share of a text one thread of vector_parse_text parses.
+ *
+ * @param *text The whole text
+ * @param start The offset of the first byte of the chunk (just after a delimiter, or 0)
+ * @param end The offset one past the last byte of the chunk
+ * @param type The type of the numbers
+ * @param *parsed The numbers parsed, in order
+ * @param error_at The offset of the first invalid number, or SIZE_MAX if there was none
+ */
+typedef struct TextImportChunk {
+	const char *text;
+	size_t start;
+	size_t end;
+	NumericType type;
+	Vector *parsed;
+	size_t error_at;
+} TextImportChunk;
+
+/**
+ * VectorStreamHeader struct.
+ * Starts a stream of Vector chunks, which follow as a StreamChunkHeader and its elements each,
+ * ending with a chunk of 0 elements.
+ *
+ * @param magic Always VECTOR_STREAM_MAGIC (not NUL terminated)
+ * @param version The stream format version (VECTOR_FILE_VERSION)
+ * @param endianness 0x01020304 as written by the sending machine
+ * @param elem_size The size (in bytes) of each element
+ */
+typedef struct VectorStreamHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int endianness;
+	unsigned long long elem_size;
+} VectorStreamHeader;
+
+/**
+ * StreamChunkHeader struct.
+ * Frames one chunk of a Vector stream.
+ *
+ * @param count The amount of elements in the chunk (0 marks the end of the stream)
+ * @param checksum hash_bytes of the chunk's elements
+ */
+typedef struct StreamChunkHeader {
+	unsigned long long count;
+	unsigned long long checksum;
+} StreamChunkHeader;
+
+/**
+ * StreamReader struct.
+ * The state shared between vector_stream_consume and its background reading thread.
+ * Each of the two buffers is either full (owned by the consumer) or not (owned by the reader).
+ *
+ * @param fd The file descriptor being read
+ * @param elem_size The size of each element
+ * @param *buffers The two chunk buffers
+ * @param capacities The size (in bytes) of each buffer
+ * @param counts The amount of elements in each full buffer (0 for the end of the stream)
+ * @param full Whether each buffer holds a chunk waiting to be consumed
+ * @param failed Whether reading failed (the stream was corrupt or cut short)
+ * @param stopped Whether the consumer has stopped, so the reader should too
+ * @param lock Guards full, failed and stopped
+ * @param changed Signalled whenever full, failed or stopped changes
+ */
+typedef struct StreamReader {
+	int fd;
+	size_t elem_size;
+	void *buffers[2];
+	size_t capacities[2];
+	size_t counts[2];
+	BOOL full[2];
+	BOOL failed;
+	BOOL stopped;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+} StreamReader;
+
+/**
+ * VectorIORequest struct.
+ * An asynchronous save or load, carried out by a pool of VECTOR_ASYNC_THREADS threads
+ * which each transfer VECTOR_ASYNC_CHUNK byte chunks of the array with pread / pwrite.
+ *
+ * @param *vector The vector being saved, or the vector being loaded (NULL until its header is read)
+ * @param fd The open file descriptor of the file
+ * @param load Whether this is a load (otherwise a save)
+ * @param direct Whether the file was opened with O_DIRECT (transfers are padded to VECTOR_DIRECT_ALIGN)
+ * @param data_bytes The size (in bytes) of the array being transferred
+ * @param checksum The checksum from the header of a file being loaded
+ * @param next_chunk The next chunk for a thread of the pool to transfer
+ * @param failed Whether any part of the request failed
+ * @param done Whether the request has finished (and its callback has returned)
+ * @param event_fd An eventfd which becomes readable once the request has finished
+ * @param callback The function pointer called (on the I/O thread) when the request finishes, or NULL
+ * @param context Passed through untouched to the callback
+ * @param thread The thread running the request
+ * @param lock Guards next_chunk, failed and done
+ * @param finished Signalled once done is set
+ */
+typedef struct VectorIORequest {
+	Vector *vector;
+	int fd;
+	BOOL load;
+	BOOL direct;
+	size_t data_bytes;
+	unsigned long long checksum;
+	size_t next_chunk;
+	BOOL failed;
+	BOOL done;
+	int event_fd;
+	void (*callback)(struct VectorIORequest *request, BOOL ok, void *context);
+	void *context;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+} VectorIORequest;
+
+/**
+ * SparseVector struct.
+ * Only elements which differ from the default value are stored, as (index, element) pairs
+ * kept in ascending index order.
+ *
+ * @param *indexes A Vector of size_t holding the logical index of each stored element (sorted)
+ * @param *elements A Vector holding the stored elements, parallel to indexes
+ * @param *default_value The value returned for any index which has not been set
+ * @param elem_size The size (in bytes) of each element
+ * @param length The logical amount of elements in the sparse vector
+ */
+typedef struct SparseVector {
+	Vector *indexes;
+	Vector *elements;
+	void *default_value;
+	size_t elem_size;
+	size_t length;
+} SparseVector;
+
+/**
+ * StringVector struct.
+ * Variable length byte strings stored back to back in a single blob, with string i
+ * occupying the bytes [offsets[i], offsets[i + 1]) of the blob.
+ *
+ * @param *blob A Vector of char holding the bytes of every string
+ * @param *offsets A Vector of size_t holding length + 1 offsets into the blob
+ * @param length The amount of strings currently stored
+ */
+typedef struct StringVector {
+	Vector *blob;
+	Vector *offsets;
+	size_t length;
+} StringVector;
+
+/**
+ * JaggedVector struct.
+ * A vector of variable length rows flattened into one values array (compressed sparse row layout),
+ * with row r occupying the elements [offsets[r], offsets[r + 1]) of values once finalized.
+ * While building, values are staged in push order alongside the row they belong to.
+ *
+ * @param *values A Vector holding every element of every row
+ * @param *offsets A Vector of size_t holding rows + 1 offsets into values (valid once finalized)
+ * @param *pending_rows A Vector of size_t holding the row of each staged value (NULL once finalized)
+ * @param elem_size The size (in bytes) of each element
+ * @param rows The amount of rows
+ * @param in_row_order Whether every value so far was pushed in non-decreasing row order
+ * @param finalized Whether finalize_jagged_vector has been called
+ */
+typedef struct JaggedVector {
+	Vector *values;
+	Vector *offsets;
+	Vector *pending_rows;
+	size_t elem_size;
+	size_t rows;
+	BOOL in_row_order;
+	BOOL finalized;
+} JaggedVector;
+
+/**
+ * MatrixView struct.
+ * A two dimensional view over the storage of an existing Vector (nothing is copied),
+ * where element (row, column) lives at index offset + row * row_stride + column * column_stride.
+ *
+ * @param *vector The vector holding the elements
+ * @param rows The amount of rows in the view
+ * @param columns The amount of columns in the view
+ * @param offset The index of element (0, 0) within the vector
+ * @param row_stride The distance (in elements) between vertically adjacent elements
+ * @param column_stride The distance (in elements) between horizontally adjacent elements
+ */
+typedef struct MatrixView {
+	Vector *vector;
+	size_t rows;
+	size_t columns;
+	size_t offset;
+	size_t row_stride;
+	size_t column_stride;
+} MatrixView;
+
+/**
+ * FlatSet struct.
+ * A set of unique elements kept in ascending order in a single Vector.
+ *
+ * @param *elements A Vector holding the elements in sorted order
+ * @param compare The function pointer ordering the elements (as in sort_vector)
+ */
+typedef struct FlatSet {
+	Vector *elements;
+	int (*compare)(void *elem1, void *elem2);
+} FlatSet;
+
+/**
+ * FlatMap struct.
+ * A map of unique keys kept in ascending order in one Vector, with values in a parallel Vector.
+ *
+ * @param *keys A Vector holding the keys in sorted order
+ * @param *values A Vector holding the value of each key, parallel to keys
+ * @param compare The function pointer ordering the keys (as in sort_vector)
+ */
+typedef struct FlatMap {
+	Vector *keys;
+	Vector *values;
+	int (*compare)(void *elem1, void *elem2);
+} FlatMap;
+
+/**
+ * BTreeNode struct.
+ * Leaves hold a small sorted Vector of elements and are chained together in order.
+ * Internal nodes hold up to BTREE_FANOUT children, separated by the elements in keys,
+ * where every element under children[i] is <= keys[i] <= every element under children[i + 1].
+ *
+ * @param is_leaf Whether this node is a leaf
+ * @param *elements Leaf: the sorted elements. Internal: the child_count - 1 separating keys
+ * @param **children The child nodes (internal nodes only)
+ * @param child_count The amount of children (internal nodes only)
+ * @param *parent The parent node, or NULL for the root
+ * @param *prev The previous leaf in order (leaves only)
+ * @param *next The next leaf in order (leaves only)
+ */
+typedef struct BTreeNode {
+	BOOL is_leaf;
+	Vector *elements;
+	struct BTreeNode **children;
+	size_t child_count;
+	struct BTreeNode *parent;
+	struct BTreeNode *prev;
+	struct BTreeNode *next;
+} BTreeNode;
+
+/**
+ * BTree struct.
+ * An ordered sequence (duplicates allowed) stored as a B+tree of small leaf Vectors.
+ *
+ * @param *root The root node
+ * @param *first_leaf The leftmost leaf, where in order iteration starts
+ * @param elem_size The size (in bytes) of each element
+ * @param length The amount of elements stored
+ * @param compare The function pointer ordering the elements (as in sort_vector)
+ */
+typedef struct BTree {
+	BTreeNode *root;
+	BTreeNode *first_leaf;
+	size_t elem_size;
+	size_t length;
+	int (*compare)(void *elem1, void *elem2);
+} BTree;
+
+/**
+ * SlotHandle struct.
+ * A stable reference to an element of a SlotMap, which goes stale once the element is removed.
+ *
+ * @param index The slot the element was given
+ * @param generation The generation of the slot when the element was given it
+ */
+typedef struct SlotHandle {
+	unsigned int index;
+	unsigned int generation;
+} SlotHandle;
+
+/**
+ * SlotMap struct.
+ * Elements are kept densely packed (in no particular order) and reached through slots, which
+ * never move. A slot holds the dense position of its element, or the next free slot once free,
+ * and a generation that is bumped whenever its element is removed.
+ *
+ * @param *elements A Vector holding the elements densely
+ * @param *dense_slots A Vector of unsigned int holding the slot of each element, parallel to elements
+ * @param *slots A Vector of SlotHandle, where index is the dense position or next free slot
+ * @param free_head The first free slot, or SLOT_MAP_NONE if there is none
+ */
+typedef struct SlotMap {
+	Vector *elements;
+	Vector *dense_slots;
+	Vector *slots;
+	unsigned int free_head;
+} SlotMap;
+
 
 /**
  * The nearest power of 2 from x upwards.
@@ -115,8 +769,20 @@ void set_elem(Vector *vector, int index, void *element);
  */
 void remove_elem(Vector *vector, int index);
 
+/**
+ * Inserts an element at an index, shifting the rest of the vector across.
+ *
+ * @param vector The vector
+ * @param index The index to insert the element at (0 <= index <= length)
+ * @param element The element to insert
+ */
+void insert_elem(Vector *vector, int index, void *element);
+
 /**
  * Searches a vector and returns the index of where a given element lies.
+ * Vectors with a Bloom filter return -1 straight away for elements it rules out.
+ * Vectors in sorted mode are binary searched, and vectors with a zone map skip
+ * every block which cannot hold the element.
  *
  * @param vector The vector to search
  * @param element The data to search for
@@ -124,6 +790,15 @@ void remove_elem(Vector *vector, int index);
  */
 int index_of(Vector *vector, void *element);
 
+/**
+ * Whether a vector holds a given element.
+ *
+ * @param vector The vector to search
+ * @param element The data to search for
+ * @return Whether the element exists
+ */
+BOOL contains(Vector *vector, void *element);
+
 /**
  * Whether the vector is currently empty.
  *
@@ -151,9 +826,21 @@ BOOL any_elems_shared(Vector *vector1, Vector *vector2);
 void swap_elems(Vector *vector, int index1, int index2);
 
 
+/**
+ * Stable merge sort of a raw array of elements (O(n log n)).
+ *
+ * @param array The elements to sort
+ * @param count The amount of elements
+ * @param elem_size The size (in bytes) of each element
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+static void merge_sort_elems(void *array, size_t count, size_t elem_size, int (*compare)(void *elem1, void *elem2));
+
 /**
  * Sorts a vector with a comparison function.
  * Uses selection sort (O(n^2)).
+ * A vector in sorted mode by the same comparison is already in order, so this does nothing;
+ * sorting it by any other comparison switches it out of sorted mode.
  *
  * @param vector The vector to sort
  * @param sort  The function pointer to compare two similar elements
@@ -163,6 +850,7 @@ void sort_vector(Vector *vector, int (*sort)(void *elem1, void *elem2));
 
 /**
  * Push an element to the back of the vector.
+ * Vectors in sorted mode insert the element at its sorted position instead.
  *
  * @param vector The vector
  * @param element The element to insert
@@ -178,283 +866,7800 @@ void push_back(Vector *vector, void *element);
 void expand_vector(Vector *vector, size_t new_size);
 
 /**
- * Memory management: Deallocate a vector.
+ * Makes sure a vector can hold at least min_capacity elements without reallocating,
+ * doubling its capacity as many times as needed.
  *
- * @param vector The vector to deallocate
+ * @param vector The vector
+ * @param min_capacity The capacity the vector must have afterwards
+ * @return Whether the vector can now hold min_capacity elements (FALSE if it is read only or cannot grow)
  */
-void free_vector(Vector *vector);
-
-
+BOOL reserve_vector(Vector *vector, size_t min_capacity);
 
 /**
- * The nearest power of 2 from x upwards.
+ * Binary searches a sorted vector for the first element not less than a given element.
  *
- * @param x The number to operate on
- * @return x if x is a power of 2, otherwise the next power of 2 greater than x
+ * @param vector The vector, sorted by compare
+ * @param element The element to search for
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @return The index of the first element >= element, or length if there is none
  */
-int next_pow_2(int x) {
-	if (x <= 2) {
-		return 1;
-	}
-	double log2 = log(x) / log(2);
-	return (int) ceil(log2);
-}
+int lower_bound(Vector *vector, void *element, int (*compare)(void *elem1, void *elem2));
 
 /**
- * Create a new vector with default size 16
+ * Binary searches a sorted vector for the first element greater than a given element.
  *
- * @param elem_size The size of each element in the vector
- * @return The generated vector
+ * @param vector The vector, sorted by compare
+ * @param element The element to search for
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @return The index of the first element > element, or length if there is none
  */
-Vector* create_vector(size_t elem_size) {
-	return create_vector_with_capacity(elem_size, 16);
-}
+int upper_bound(Vector *vector, void *element, int (*compare)(void *elem1, void *elem2));
 
 /**
- * Creates a new vector and fills it with initial_size default values of default_value.
+ * Switches a vector into sorted mode: it is sorted once now and kept sorted by compare from then on.
+ * While in sorted mode, set_elem, insert_elem and swap_elems must not be used to break the order.
  *
- * @param elem_size The size of each element in the vector
- * @param initial_size The initial size to create the vector with default values
- * @param default_value The default value to fill the vector with
- * @return The generated vector
+ * @param vector The vector
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
  */
-Vector* create_vector_with_default(size_t elem_size, size_t initial_size, void *default_value) {
-	Vector *vector = create_vector_with_capacity(elem_size, initial_size);
-
-	for (int i = 0; i < initial_size; i++) {
-		push_back(vector, default_value);
-	}
-
-	return vector;
-}
+void make_vector_sorted(Vector *vector, int (*compare)(void *elem1, void *elem2));
 
 /**
- * Creates a new vector with *at least* initial_size capacity (the next power of 2 for ease of management).
+ * Switches a vector out of sorted mode (its elements stay where they are).
  *
- * @param elem_size The size of each element in the vector
- * @param initial_size The capacity at which the vector will have a minimum of
- * @return The generated vector
+ * @param vector The vector
  */
-Vector* create_vector_with_capacity(size_t elem_size, size_t initial_size) {
-	size_t actual_size = (size_t) pow(2, next_pow_2(initial_size));
-
-	void *array = calloc(actual_size, elem_size);
-
-	Vector *vector = malloc(sizeof(Vector));
-	vector->array = array;
-	vector->elem_size = elem_size;
-	vector->length = 0;
-	vector->capacity = actual_size;
-
-	return vector;
-}
+void make_vector_unsorted(Vector *vector);
 
 /**
- * Clones a vector into new memory.
+ * Inserts an element into a vector in sorted mode at its sorted position (after any equal elements).
+ * Uses a binary search and a single memmove.
  *
- * @param old The old vector to copy from
- * @return The new copied vector
+ * @param vector The vector in sorted mode
+ * @param element The element to insert
+ * @return The index the element was inserted at
  */
-Vector* clone(Vector* old) {
-	Vector *new = malloc(sizeof(Vector));
-	void *array = calloc(old->capacity, old->elem_size);
-
-	new->array = array;
-	new->elem_size = old->elem_size;
-	new->length = old->length;
-	new->capacity = old->capacity;
-	memcpy(array, old->array, old->elem_size * old->length);
+int insert_sorted(Vector *vector, void *element);
 
-	return new;
-}
+/**
+ * Inserts a batch of elements into a vector already sorted by compare, keeping it sorted.
+ * The batch is sorted, the vector grown once, and the two merged from the back into the free tail,
+ * galloping (exponential then binary search) to find where each batch element lands so that runs
+ * of the vector are moved with one memmove each (O(n + k log k)).
+ * Batch elements are placed after any equal elements already in the vector.
+ *
+ * @param vector The vector, sorted by compare
+ * @param batch The vector of elements to insert (left untouched)
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+void merge_insert_sorted(Vector *vector, Vector *batch, int (*compare)(void *elem1, void *elem2));
 
 /**
- * Gets the element at a specific index of the vector.
+ * Memory management: Deallocate a vector.
  *
- * @param vector The vector
- * @param index The index to retrieve the element from
- * @return The value as void*
+ * @param vector The vector to deallocate
  */
-void* get_elem(Vector *vector, int index) {
-	return (void*) (vector->array + (index * vector->elem_size));
-}
+void free_vector(Vector *vector);
 
 /**
- * Sets an element at a particular index to a given value
+ * Notifies everything attached to a vector that the elements in [from, to) changed and/or
+ * that its length changed. Every vector function calls this itself; it is only needed
+ * after writing to vector->array or vector->length directly.
  *
  * @param vector The vector
- * @param index The index to set the element of
- * @param element The data to set the element to
+ * @param from The first changed index
+ * @param to One past the last changed index
  */
-void set_elem(Vector *vector, int index, void *element) {
-	memcpy(vector->array + (index * vector->elem_size), element, vector->elem_size);
-}
+void vector_modified(Vector *vector, size_t from, size_t to);
 
 /**
- * Removes an element from a vector and shifts the rest of the vector across.
+ * Reads an element of a numeric type as a double.
  *
- * @param vector The vector
- * @param index The index of the item to remove
+ * @param type The type of the element
+ * @param element The element
+ * @return The value of the element
  */
-void remove_elem(Vector *vector, int index) {
-	for (int i = index + 1; i < vector->length; i++) {
-		void *next_elem = get_elem(vector, i);
-		set_elem(vector, i - 1, next_elem);
+double numeric_value(NumericType type, void *element);
+
+/**
+ * The size (in bytes) of an element of a numeric type.
+ *
+ * @param type The type
+ * @return The size of the type
+ */
+size_t numeric_size(NumericType type);
+
+/**
+ * Whether a vector is read only (see open_readonly_vector).
+ *
+ * @param vector The vector
+ * @return Whether it may not be modified
+ */
+BOOL is_read_only(Vector *vector);
+
+/**
+ * Complains if a vector is read only. Every mutating vector function checks this first.
+ *
+ * @param vector The vector
+ * @param function The name of the function attempting to modify the vector
+ * @return Whether the vector may be modified
+ */
+BOOL check_writable(Vector *vector, const char *function);
+
+/**
+ * A 64 bit hash of some bytes, mixed a word at a time.
+ *
+ * @param data The bytes to hash
+ * @param length The amount of bytes
+ * @return The hash
+ */
+unsigned long long hash_bytes(const void *data, size_t length);
+
+/**
+ * Creates a new sparse vector of a given logical length where every element is default_value.
+ *
+ * @param elem_size The size of each element in the vector
+ * @param length The logical length of the sparse vector
+ * @param default_value The value every index holds until it is set
+ * @return The generated sparse vector
+ */
+SparseVector* create_sparse_vector(size_t elem_size, size_t length, void *default_value);
+
+/**
+ * Gets the element at a specific index of the sparse vector.
+ *
+ * @param sparse The sparse vector
+ * @param index The index to retrieve the element from
+ * @return The stored value, or the default value if the index has not been set
+ */
+void* sparse_get_elem(SparseVector *sparse, size_t index);
+
+/**
+ * Sets an element at a particular index of the sparse vector.
+ * Setting an index back to the default value releases its storage.
+ *
+ * @param sparse The sparse vector
+ * @param index The index to set the element of
+ * @param element The data to set the element to
+ */
+void sparse_set_elem(SparseVector *sparse, size_t index, void *element);
+
+/**
+ * Push an element to the back of the sparse vector.
+ *
+ * @param sparse The sparse vector
+ * @param element The element to insert
+ */
+void sparse_push_back(SparseVector *sparse, void *element);
+
+/**
+ * The amount of elements actually stored (ie. those which differ from the default value).
+ *
+ * @param sparse The sparse vector
+ * @return The populated element count
+ */
+size_t sparse_populated_count(SparseVector *sparse);
+
+/**
+ * Iterates over the populated elements of a sparse vector in ascending index order.
+ *
+ * @param sparse The sparse vector
+ * @param visit The function pointer called with each populated index and element
+ * @param context Passed through untouched to every call of visit
+ */
+void sparse_for_each(SparseVector *sparse, void (*visit)(size_t index, void *element, void *context), void *context);
+
+/**
+ * Expands a sparse vector into a regular (dense) vector.
+ *
+ * @param sparse The sparse vector
+ * @return A new vector holding every logical element of the sparse vector
+ */
+Vector* sparse_to_vector(SparseVector *sparse);
+
+/**
+ * Memory management: Deallocate a sparse vector.
+ *
+ * @param sparse The sparse vector to deallocate
+ */
+void free_sparse_vector(SparseVector *sparse);
+
+/**
+ * Create a new, empty string vector.
+ *
+ * @return The generated string vector
+ */
+StringVector* create_string_vector();
+
+/**
+ * Push a string to the back of the string vector (the bytes are copied into the blob).
+ *
+ * @param strings The string vector
+ * @param string The bytes of the string (need not be NUL terminated)
+ * @param length The amount of bytes in the string
+ */
+void string_push_back(StringVector *strings, const char *string, size_t length);
+
+/**
+ * Gets the string at a specific index without copying it.
+ * The returned pointer is invalidated by the next push_back or sort.
+ *
+ * @param strings The string vector
+ * @param index The index to retrieve the string from
+ * @param length Set to the amount of bytes in the string (may be NULL)
+ * @return A pointer to the first byte of the string (not NUL terminated)
+ */
+const char* string_get_elem(StringVector *strings, int index, size_t *length);
+
+/**
+ * Searches a string vector and returns the index of where a given string lies.
+ *
+ * @param strings The string vector to search
+ * @param string The bytes to search for
+ * @param length The amount of bytes in the string
+ * @return The index of the found string, or -1 if it does not exist
+ */
+int string_index_of(StringVector *strings, const char *string, size_t length);
+
+/**
+ * Sorts a string vector bytewise (shorter strings first on a common prefix).
+ * Uses multikey quicksort (O(n log n + total distinguishing prefix bytes)),
+ * then rewrites the blob in sorted order so neighbouring strings stay adjacent in memory.
+ *
+ * @param strings The string vector to sort
+ */
+void sort_string_vector(StringVector *strings);
+
+/**
+ * Memory management: Deallocate a string vector.
+ *
+ * @param strings The string vector to deallocate
+ */
+void free_string_vector(StringVector *strings);
+
+/**
+ * Create a new, empty jagged vector ready for building.
+ *
+ * @param elem_size The size of each element in the vector
+ * @param rows The initial amount of (empty) rows
+ * @return The generated jagged vector
+ */
+JaggedVector* create_jagged_vector(size_t elem_size, size_t rows);
+
+/**
+ * Push an element to the back of a row while building a jagged vector.
+ * Pushing to a row past the end grows the jagged vector to include it.
+ *
+ * @param jagged The jagged vector
+ * @param row The row to append to
+ * @param element The element to insert
+ */
+void jagged_row_push(JaggedVector *jagged, size_t row, void *element);
+
+/**
+ * Finishes building a jagged vector, compacting every row contiguously in a single pass.
+ * No more elements may be pushed afterwards.
+ *
+ * @param jagged The jagged vector
+ */
+void finalize_jagged_vector(JaggedVector *jagged);
+
+/**
+ * Gets a row of a finalized jagged vector without copying it.
+ *
+ * @param jagged The jagged vector
+ * @param row The row to retrieve
+ * @param length Set to the amount of elements in the row (may be NULL)
+ * @return A pointer to the first element of the row
+ */
+void* jagged_get_row(JaggedVector *jagged, size_t row, size_t *length);
+
+/**
+ * Gets a single element of a finalized jagged vector.
+ *
+ * @param jagged The jagged vector
+ * @param row The row of the element
+ * @param column The position of the element within its row
+ * @return The value as void*
+ */
+void* jagged_get_elem(JaggedVector *jagged, size_t row, size_t column);
+
+/**
+ * Memory management: Deallocate a jagged vector.
+ *
+ * @param jagged The jagged vector to deallocate
+ */
+void free_jagged_vector(JaggedVector *jagged);
+
+/**
+ * Creates a row-major matrix view over a vector.
+ *
+ * @param vector The vector holding at least rows * columns elements
+ * @param rows The amount of rows
+ * @param columns The amount of columns
+ * @return The matrix view, or an empty (0 x 0) view if the vector is too small
+ */
+MatrixView matrix_view(Vector *vector, size_t rows, size_t columns);
+
+/**
+ * A view of the transpose of a matrix (only the strides are swapped, nothing is moved).
+ *
+ * @param matrix The matrix view
+ * @return The transposed matrix view
+ */
+MatrixView matrix_transpose_view(MatrixView matrix);
+
+/**
+ * Gets the element at a specific row and column of a matrix view.
+ *
+ * @param matrix The matrix view
+ * @param row The row of the element
+ * @param column The column of the element
+ * @return The value as void*
+ */
+void* matrix_get_elem(MatrixView matrix, size_t row, size_t column);
+
+/**
+ * Copies the transpose of a matrix into another matrix, one cache sized block at a time.
+ * A square matrix may be transposed in place by passing the same view twice; otherwise
+ * the two views may not overlap.
+ *
+ * @param source The matrix view to transpose (rows x columns)
+ * @param destination The matrix view to write into (columns x rows)
+ */
+void matrix_transpose(MatrixView source, MatrixView destination);
+
+/**
+ * Blocked matrix multiply of floats: result = left * right.
+ *
+ * @param left The left matrix view (n x k) of floats
+ * @param right The right matrix view (k x m) of floats
+ * @param result The matrix view to write into (n x m) of floats, which may not overlap left or right
+ */
+void matrix_multiply_float(MatrixView left, MatrixView right, MatrixView result);
+
+/**
+ * Blocked matrix multiply of doubles: result = left * right.
+ *
+ * @param left The left matrix view (n x k) of doubles
+ * @param right The right matrix view (k x m) of doubles
+ * @param result The matrix view to write into (n x m) of doubles, which may not overlap left or right
+ */
+void matrix_multiply_double(MatrixView left, MatrixView right, MatrixView result);
+
+/**
+ * Sums every row of a matrix of doubles.
+ *
+ * @param matrix The matrix view of doubles
+ * @param sums Filled with one sum per row (must hold matrix.rows doubles)
+ */
+void matrix_row_sums_double(MatrixView matrix, double *sums);
+
+/**
+ * Sums every column of a matrix of doubles.
+ *
+ * @param matrix The matrix view of doubles
+ * @param sums Filled with one sum per column (must hold matrix.columns doubles)
+ */
+void matrix_column_sums_double(MatrixView matrix, double *sums);
+
+/**
+ * Sums every row of a matrix of floats.
+ *
+ * @param matrix The matrix view of floats
+ * @param sums Filled with one sum per row (must hold matrix.rows floats)
+ */
+void matrix_row_sums_float(MatrixView matrix, float *sums);
+
+/**
+ * Sums every column of a matrix of floats.
+ *
+ * @param matrix The matrix view of floats
+ * @param sums Filled with one sum per column (must hold matrix.columns floats)
+ */
+void matrix_column_sums_float(MatrixView matrix, float *sums);
+
+/**
+ * Create a new, empty flat set.
+ *
+ * @param elem_size The size of each element in the set
+ * @param compare The function pointer ordering the elements (as in sort_vector)
+ * @return The generated flat set
+ */
+FlatSet* create_flat_set(size_t elem_size, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Searches a flat set for an element (O(log n)).
+ *
+ * @param set The flat set
+ * @param element The element to search for
+ * @return The index of the found element, or -1 if it does not exist
+ */
+int flat_set_find(FlatSet *set, void *element);
+
+/**
+ * Inserts an element into a flat set, keeping it sorted with a single memmove.
+ *
+ * @param set The flat set
+ * @param element The element to insert
+ * @return Whether the element was inserted (FALSE if it was already present)
+ */
+BOOL flat_set_insert(FlatSet *set, void *element);
+
+/**
+ * Inserts many elements into a flat set at once.
+ * The batch is sorted and then merged into the set from the back, growing the set only once.
+ *
+ * @param set The flat set
+ * @param batch The vector of elements to insert (left untouched)
+ * @return The amount of elements which were not already present
+ */
+size_t flat_set_insert_bulk(FlatSet *set, Vector *batch);
+
+/**
+ * Removes an element from a flat set, keeping it sorted.
+ *
+ * @param set The flat set
+ * @param element The element to remove
+ * @return Whether the element was present
+ */
+BOOL flat_set_erase(FlatSet *set, void *element);
+
+/**
+ * Finds every element of a flat set within [low, high).
+ *
+ * @param set The flat set
+ * @param low The inclusive lower bound
+ * @param high The exclusive upper bound
+ * @param first Set to the index of the first element in range
+ * @return The amount of elements in range (they lie contiguously from first)
+ */
+size_t flat_set_range(FlatSet *set, void *low, void *high, int *first);
+
+/**
+ * Memory management: Deallocate a flat set.
+ *
+ * @param set The flat set to deallocate
+ */
+void free_flat_set(FlatSet *set);
+
+/**
+ * Create a new, empty flat map.
+ *
+ * @param key_size The size of each key in the map
+ * @param value_size The size of each value in the map
+ * @param compare The function pointer ordering the keys (as in sort_vector)
+ * @return The generated flat map
+ */
+FlatMap* create_flat_map(size_t key_size, size_t value_size, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Looks up the value of a key in a flat map (O(log n)).
+ *
+ * @param map The flat map
+ * @param key The key to search for
+ * @return The value as void*, or NULL if the key does not exist
+ */
+void* flat_map_find(FlatMap *map, void *key);
+
+/**
+ * Inserts a key and value into a flat map, overwriting the value if the key already exists.
+ *
+ * @param map The flat map
+ * @param key The key to insert
+ * @param value The value to associate with the key
+ * @return Whether the key was new
+ */
+BOOL flat_map_insert(FlatMap *map, void *key, void *value);
+
+/**
+ * Inserts many keys and values into a flat map at once.
+ * The batch is sorted and then merged into the map from the back, growing the map only once.
+ * Where a key appears more than once, the value pushed last wins.
+ *
+ * @param map The flat map
+ * @param keys The vector of keys to insert (left untouched)
+ * @param values The vector of values to insert, parallel to keys (left untouched)
+ * @return The amount of keys which were not already present
+ */
+size_t flat_map_insert_bulk(FlatMap *map, Vector *keys, Vector *values);
+
+/**
+ * Removes a key and its value from a flat map.
+ *
+ * @param map The flat map
+ * @param key The key to remove
+ * @return Whether the key was present
+ */
+BOOL flat_map_erase(FlatMap *map, void *key);
+
+/**
+ * Finds every key of a flat map within [low, high).
+ *
+ * @param map The flat map
+ * @param low The inclusive lower bound
+ * @param high The exclusive upper bound
+ * @param first Set to the index (into keys and values) of the first key in range
+ * @return The amount of keys in range (they lie contiguously from first)
+ */
+size_t flat_map_range(FlatMap *map, void *low, void *high, int *first);
+
+/**
+ * Memory management: Deallocate a flat map.
+ *
+ * @param map The flat map to deallocate
+ */
+void free_flat_map(FlatMap *map);
+
+/**
+ * Merges many vectors, each sorted by compare, into one sorted output appended to out.
+ * Uses a loser tree, so each output element costs O(log count) comparisons.
+ *
+ * @param vectors The sorted vectors to merge (left untouched)
+ * @param count The amount of vectors
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @param dedup Whether to drop elements which compare equal to the one output before them
+ * @param out The vector to append the merged elements to
+ * @return The amount of elements appended
+ */
+size_t kway_merge(Vector **vectors, int count, int (*compare)(void *elem1, void *elem2), BOOL dedup, Vector *out);
+
+/**
+ * Merges many vectors, each sorted by compare, handing every merged element to a callback
+ * as it is produced instead of storing it (eg. so it can be written straight out).
+ * Ties between vectors are output in the order the vectors are given.
+ *
+ * @param vectors The sorted vectors to merge (left untouched)
+ * @param count The amount of vectors
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @param dedup Whether to drop elements which compare equal to the one output before them
+ * @param emit The function pointer called with each merged element, in order
+ * @param context Passed through untouched to every call of emit
+ * @return The amount of elements emitted
+ */
+size_t kway_merge_stream(Vector **vectors, int count, int (*compare)(void *elem1, void *elem2), BOOL dedup,
+		void (*emit)(void *element, void *context), void *context);
+
+/**
+ * Rearranges a vector into a binary min-heap (the element compare orders first sits at index 0) in O(n).
+ *
+ * @param vector The vector
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+void heapify(Vector *vector, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Pushes an element onto a binary heap (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param element The element to push
+ * @param compare The function pointer the heap is ordered by
+ */
+void heap_push(Vector *vector, void *element, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Pops the first element off a binary heap (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param out Filled with the popped element (may be NULL)
+ * @param compare The function pointer the heap is ordered by
+ * @return Whether an element was popped (FALSE if the heap was empty)
+ */
+BOOL heap_pop(Vector *vector, void *out, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Pops the first element off a binary heap and pushes a new one in a single pass (O(log n)).
+ * Cheaper than a heap_pop followed by a heap_push.
+ *
+ * @param vector The vector holding the heap
+ * @param element The element to push
+ * @param out Filled with the popped element (may be NULL)
+ * @param compare The function pointer the heap is ordered by
+ * @return Whether an element was popped (FALSE if the heap was empty, in which case element is just pushed)
+ */
+BOOL heap_replace(Vector *vector, void *element, void *out, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Rearranges a vector into a d-ary min-heap in O(n).
+ * Wider heaps (eg. arity 4) are shallower and keep each node's children on one cache line.
+ *
+ * @param vector The vector
+ * @param arity The amount of children per node (at least 2)
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+void heapify_dary(Vector *vector, int arity, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Pushes an element onto a d-ary heap (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param arity The amount of children per node (at least 2)
+ * @param element The element to push
+ * @param compare The function pointer the heap is ordered by
+ */
+void heap_push_dary(Vector *vector, int arity, void *element, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Pops the first element off a d-ary heap (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param arity The amount of children per node (at least 2)
+ * @param out Filled with the popped element (may be NULL)
+ * @param compare The function pointer the heap is ordered by
+ * @return Whether an element was popped (FALSE if the heap was empty)
+ */
+BOOL heap_pop_dary(Vector *vector, int arity, void *out, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Pops the first element off a d-ary heap and pushes a new one in a single pass (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param arity The amount of children per node (at least 2)
+ * @param element The element to push
+ * @param out Filled with the popped element (may be NULL)
+ * @param compare The function pointer the heap is ordered by
+ * @return Whether an element was popped (FALSE if the heap was empty, in which case element is just pushed)
+ */
+BOOL heap_replace_dary(Vector *vector, int arity, void *element, void *out, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Create a new, empty B+tree.
+ *
+ * @param elem_size The size of each element in the tree
+ * @param compare The function pointer ordering the elements (as in sort_vector)
+ * @return The generated B+tree
+ */
+BTree* create_btree(size_t elem_size, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Creates a B+tree holding every element of a vector already sorted by compare.
+ * The leaves are filled to three quarters straight from the vector and the tree built bottom up (O(n)).
+ *
+ * @param sorted The vector to load, sorted by compare (left untouched)
+ * @param compare The function pointer ordering the elements (as in sort_vector)
+ * @return The generated B+tree
+ */
+BTree* create_btree_from_sorted(Vector *sorted, int (*compare)(void *elem1, void *elem2));
+
+/**
+ * Inserts an element into a B+tree (O(log n)), after any elements equal to it.
+ *
+ * @param tree The B+tree
+ * @param element The element to insert
+ */
+void btree_insert(BTree *tree, void *element);
+
+/**
+ * Searches a B+tree for an element (O(log n)).
+ *
+ * @param tree The B+tree
+ * @param element The element to search for
+ * @return The first stored element comparing equal, or NULL if there is none
+ */
+void* btree_find(BTree *tree, void *element);
+
+/**
+ * Removes one element comparing equal to a given element from a B+tree (O(log n)).
+ * Leaves are not merged as they shrink, only released once empty.
+ *
+ * @param tree The B+tree
+ * @param element The element to remove
+ * @return Whether an element was removed
+ */
+BOOL btree_erase(BTree *tree, void *element);
+
+/**
+ * Iterates over every element of a B+tree in order, one contiguous leaf at a time.
+ *
+ * @param tree The B+tree
+ * @param visit The function pointer called with each element
+ * @param context Passed through untouched to every call of visit
+ */
+void btree_for_each(BTree *tree, void (*visit)(void *element, void *context), void *context);
+
+/**
+ * Memory management: Deallocate a B+tree.
+ *
+ * @param tree The B+tree to deallocate
+ */
+void free_btree(BTree *tree);
+
+/**
+ * Create a new, empty slot map.
+ *
+ * @param elem_size The size of each element in the slot map
+ * @return The generated slot map
+ */
+SlotMap* create_slot_map(size_t elem_size);
+
+/**
+ * Inserts an element into a slot map (O(1)), reusing a free slot if there is one.
+ *
+ * @param map The slot map
+ * @param element The element to insert
+ * @return The handle to the element, valid until it is removed
+ */
+SlotHandle slot_map_insert(SlotMap *map, void *element);
+
+/**
+ * Gets the element a handle refers to (O(1)).
+ *
+ * @param map The slot map
+ * @param handle The handle
+ * @return The value as void*, or NULL if the handle is stale
+ */
+void* slot_map_get(SlotMap *map, SlotHandle handle);
+
+/**
+ * Removes the element a handle refers to (O(1)).
+ * The last dense element is moved into its place, so other handles stay valid.
+ *
+ * @param map The slot map
+ * @param handle The handle
+ * @return Whether an element was removed (FALSE if the handle was stale)
+ */
+BOOL slot_map_remove(SlotMap *map, SlotHandle handle);
+
+/**
+ * The handle of the element at a dense position, for use while iterating over map->elements.
+ *
+ * @param map The slot map
+ * @param dense The position within map->elements
+ * @return The handle to that element
+ */
+SlotHandle slot_map_handle_at(SlotMap *map, int dense);
+
+/**
+ * Memory management: Deallocate a slot map.
+ *
+ * @param map The slot map to deallocate
+ */
+void free_slot_map(SlotMap *map);
+
+/**
+ * Attaches a range query index to a numeric vector, answering range sums, minimums and
+ * maximums in O(log n) and updated in O(log n) on every set_elem and push_back.
+ * Replaces any index already attached.
+ *
+ * @param vector The vector
+ * @param type The type of the vector's elements
+ * @return Whether the index was attached (FALSE if type does not match elem_size)
+ */
+BOOL attach_range_index(Vector *vector, NumericType type);
+
+/**
+ * Detaches (and deallocates) the range query index of a vector, if it has one.
+ *
+ * @param vector The vector
+ */
+void detach_range_index(Vector *vector);
+
+/**
+ * Rebuilds the range query index of a vector from scratch in O(n).
+ *
+ * @param vector The vector
+ */
+void range_index_rebuild(Vector *vector);
+
+/**
+ * Brings the range query index of a vector up to date after the elements in [from, to) changed,
+ * and/or its length changed. Called by vector_modified.
+ *
+ * @param vector The vector
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void range_index_update(Vector *vector, size_t from, size_t to);
+
+/**
+ * The sum of the elements in [from, to) of a vector with a range index (O(log n)).
+ * Float and double sums are updated incrementally, so rounding error can build up over many
+ * updates (range_index_rebuild recomputes them); integer sums are exact (see range_sum_integer).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @return The sum
+ */
+double range_sum(Vector *vector, size_t from, size_t to);
+
+/**
+ * The exact sum of the elements in [from, to) of an int or long vector with a range index (O(log n)).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @return The sum (wrapped, as long long arithmetic would, if it does not fit)
+ */
+long long range_sum_integer(Vector *vector, size_t from, size_t to);
+
+/**
+ * The smallest element in [from, to) of a vector with a range index (O(log n)).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @return The minimum, or +INFINITY for an empty range
+ */
+double range_min(Vector *vector, size_t from, size_t to);
+
+/**
+ * The largest element in [from, to) of a vector with a range index (O(log n)).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @return The maximum, or -INFINITY for an empty range
+ */
+double range_max(Vector *vector, size_t from, size_t to);
+
+/**
+ * Attaches a zone map to a numeric vector, summarising every block of block_size elements
+ * with its min, max and count. It is kept up to date by push_back, set_elem and friends,
+ * and lets index_of and filter_range skip blocks which cannot match.
+ * Replaces any zone map already attached.
+ *
+ * @param vector The vector
+ * @param type The type of the vector's elements
+ * @param block_size The amount of elements per block (eg. ZONE_MAP_BLOCK_SIZE)
+ * @return Whether the zone map was attached (FALSE if type does not match elem_size)
+ */
+BOOL attach_zone_map(Vector *vector, NumericType type, size_t block_size);
+
+/**
+ * Detaches (and deallocates) the zone map of a vector, if it has one.
+ *
+ * @param vector The vector
+ */
+void detach_zone_map(Vector *vector);
+
+/**
+ * Brings the zone map of a vector up to date after the elements in [from, to) changed,
+ * and/or its length changed. Called by vector_modified.
+ * A single changed element only widens its zone; anything else resummarises the blocks it touches.
+ *
+ * @param vector The vector
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void zone_map_update(Vector *vector, size_t from, size_t to);
+
+/**
+ * Finds the index of every element of a zone mapped vector within [low, high],
+ * scanning only the blocks whose zones overlap that range.
+ *
+ * @param vector The vector with a zone map
+ * @param low The inclusive lower bound
+ * @param high The inclusive upper bound
+ * @return A new vector of int holding the matching indexes in ascending order
+ */
+Vector* filter_range(Vector *vector, double low, double high);
+
+/**
+ * index_of for a vector with a zone map: only blocks whose [min, max] holds the element are scanned.
+ *
+ * @param vector The vector with a zone map
+ * @param element The data to search for
+ * @return The index of the found element, or -1 if it does not exist
+ */
+int zone_map_index_of(Vector *vector, void *element);
+
+/**
+ * Attaches a blocked Bloom filter to a vector, kept up to date by push_back, set_elem and friends,
+ * so index_of and contains can reject most missing elements without scanning.
+ * Replaces any Bloom filter already attached.
+ *
+ * @param vector The vector
+ */
+void attach_bloom_filter(Vector *vector);
+
+/**
+ * Detaches (and deallocates) the Bloom filter of a vector, if it has one.
+ *
+ * @param vector The vector
+ */
+void detach_bloom_filter(Vector *vector);
+
+/**
+ * Rebuilds the Bloom filter of a vector from its current elements, sized for twice as many,
+ * clearing out any false positives left behind by removed or overwritten elements.
+ * Happens automatically once the filter fills up or half of it has gone stale.
+ *
+ * @param vector The vector
+ */
+void bloom_filter_rebuild(Vector *vector);
+
+/**
+ * Brings the Bloom filter of a vector up to date after the elements in [from, to) changed,
+ * and/or its length changed. Called by vector_modified.
+ *
+ * @param vector The vector
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void bloom_filter_update(Vector *vector, size_t from, size_t to);
+
+/**
+ * Marks the blocks holding [from, to) of a vector dirty. Called by vector_modified.
+ *
+ * @param vector The vector with dirty tracking
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void dirty_map_update(Vector *vector, size_t from, size_t to);
+
+/**
+ * Whether a vector's Bloom filter allows that it may hold an element.
+ * FALSE is definite, TRUE may be a false positive.
+ *
+ * @param vector The vector with a Bloom filter
+ * @param element The data to test for
+ * @return Whether the element may be in the vector
+ */
+BOOL bloom_filter_may_contain(Vector *vector, void *element);
+
+/**
+ * Create a new, empty interning vector.
+ *
+ * @param elem_size The size of each element in the vector
+ * @return The generated interning vector
+ */
+InternVector* create_intern_vector(size_t elem_size);
+
+/**
+ * Interns an element: returns the index it already has, or pushes it to the back and
+ * returns its new index (O(1) expected). Indexes never change.
+ *
+ * @param interned The interning vector
+ * @param element The element to intern
+ * @return The index of the element
+ */
+int intern(InternVector *interned, void *element);
+
+/**
+ * Looks up the index of an element without interning it (O(1) expected).
+ *
+ * @param interned The interning vector
+ * @param element The element to search for
+ * @return The index of the element, or -1 if it has not been interned
+ */
+int intern_index_of(InternVector *interned, void *element);
+
+/**
+ * Memory management: Deallocate an interning vector.
+ *
+ * @param interned The interning vector to deallocate
+ */
+void free_intern_vector(InternVector *interned);
+
+/**
+ * Writes a vector to an open file descriptor: a VectorFileHeader followed by the raw array,
+ * written with as few (vectored) system calls as possible.
+ *
+ * @param vector The vector to write
+ * @param fd The file descriptor to write to (from its current position)
+ * @return Whether the whole vector was written
+ */
+BOOL vector_write_fd(Vector *vector, int fd);
+
+/**
+ * Reads a vector written by vector_write_fd from an open file descriptor,
+ * straight into a single allocation of the right size.
+ *
+ * @param fd The file descriptor to read from (from its current position)
+ * @return The loaded vector, or NULL if the data is missing, corrupt or from an incompatible machine
+ */
+Vector* vector_read_fd(int fd);
+
+/**
+ * Saves a vector to a file (see vector_write_fd), replacing anything already there.
+ *
+ * @param vector The vector to save
+ * @param path The path of the file
+ * @return Whether the vector was saved
+ */
+BOOL vector_save(Vector *vector, const char *path);
+
+/**
+ * Loads a vector saved by vector_save.
+ *
+ * @param path The path of the file
+ * @return The loaded vector, or NULL if the file could not be read or is invalid
+ */
+Vector* vector_load(const char *path);
+
+/**
+ * Creates a new vector whose array is a memory mapping of a (new or truncated) file,
+ * so its contents persist without ever being saved. The file uses the vector_save format.
+ *
+ * @param path The path of the file
+ * @param elem_size The size of each element in the vector
+ * @param initial_size The capacity to create the file with
+ * @return The generated vector, or NULL if the file could not be created
+ */
+Vector* create_mapped_vector(const char *path, size_t elem_size, size_t initial_size);
+
+/**
+ * Opens a vector file (from create_mapped_vector or vector_save) as a memory mapped vector.
+ * Nothing is read up front: pages are loaded as they are touched, and changes are written back to the file.
+ *
+ * @param path The path of the file
+ * @return The vector, or NULL if the file could not be opened or is invalid
+ */
+Vector* open_mapped_vector(const char *path);
+
+/**
+ * Flushes the changes to a memory mapped vector to its file, blocking until they are on disk.
+ *
+ * @param vector The memory mapped vector
+ * @return Whether the flush succeeded
+ */
+BOOL sync_vector(Vector *vector);
+
+/**
+ * Opens a file saved by vector_save as a read only vector pointing straight at the file's pages
+ * (nothing is copied or read up front, and processes opening the same file share the page cache).
+ * Every call which would modify it fails with an error; clone it for a private, writable copy.
+ * The checksum is not verified, since that would read the whole file.
+ *
+ * @param path The path of the file
+ * @return The read only vector, or NULL if the file could not be opened or is invalid
+ */
+Vector* open_readonly_vector(const char *path);
+
+/**
+ * Unmaps a memory mapped vector and closes its file (free_vector does this itself).
+ * The vector's array is left NULL.
+ *
+ * @param vector The memory mapped vector
+ */
+void unmap_vector(Vector *vector);
+
+/**
+ * Grows the file behind a memory mapped vector and remaps it (expand_vector does this itself).
+ * Shared memory vectors cannot grow past the capacity they reserved.
+ *
+ * @param vector The memory mapped vector
+ * @param new_size The capacity to grow to
+ */
+void expand_mapped_vector(Vector *vector, size_t new_size);
+
+/**
+ * Streams elements from a producer callback to a file descriptor (eg. a pipe) as framed chunks,
+ * so the whole sequence never has to be held in memory.
+ *
+ * @param fd The file descriptor to write to
+ * @param elem_size The size of each element
+ * @param chunk_size The maximum amount of elements per chunk (eg. VECTOR_STREAM_CHUNK / elem_size)
+ * @param produce The function pointer filling buffer with up to max elements, returning how many (0 when done)
+ * @param context Passed through untouched to every call of produce
+ * @return Whether everything was written
+ */
+BOOL vector_stream_produce(int fd, size_t elem_size, size_t chunk_size,
+		size_t (*produce)(void *buffer, size_t max, void *context), void *context);
+
+/**
+ * Streams a vector to a file descriptor as framed chunks.
+ *
+ * @param vector The vector to stream
+ * @param fd The file descriptor to write to
+ * @return Whether everything was written
+ */
+BOOL vector_stream_write(Vector *vector, int fd);
+
+/**
+ * Reads a stream of chunks from a file descriptor, handing each chunk to a consumer callback.
+ * A background thread reads the next chunk while the consumer works on the current one,
+ * so at most two chunks are ever held in memory.
+ *
+ * @param fd The file descriptor to read from
+ * @param consume The function pointer called with each chunk's elements, element count and element size
+ * @param context Passed through untouched to every call of consume
+ * @return The element size of the stream, or 0 if it was invalid, corrupt or cut short (or the reader thread could not start)
+ */
+size_t vector_stream_consume(int fd, void (*consume)(void *elements, size_t count, size_t elem_size, void *context),
+		void *context);
+
+/**
+ * Reads a stream of chunks from a file descriptor into a new vector.
+ *
+ * @param fd The file descriptor to read from
+ * @return The vector, or NULL if the stream was invalid, corrupt or cut short
+ */
+Vector* vector_stream_read(int fd);
+
+/**
+ * Starts saving a vector to a file (in the format of vector_save) in the background.
+ * The vector must not be modified or freed until the request has finished.
+ *
+ * @param vector The vector to save
+ * @param path The path of the file, which is replaced
+ * @param direct Whether to bypass the page cache with O_DIRECT (ignored where the file system lacks it)
+ * @param callback The function pointer called on the I/O thread once the save finishes, or NULL
+ * @param context Passed through untouched to the callback
+ * @return The request, or NULL if the file could not be opened or the I/O thread could not be started
+ */
+VectorIORequest* vector_save_async(Vector *vector, const char *path, BOOL direct,
+		void (*callback)(VectorIORequest *request, BOOL ok, void *context), void *context);
+
+/**
+ * Starts loading a vector saved by vector_save (or vector_save_async) in the background.
+ * Collect the vector with vector_io_take.
+ *
+ * @param path The path of the file
+ * @param direct Whether to bypass the page cache with O_DIRECT (ignored where the file system lacks it)
+ * @param callback The function pointer called on the I/O thread once the load finishes, or NULL
+ * @param context Passed through untouched to the callback
+ * @return The request, or NULL if the file could not be opened or the I/O thread could not be started
+ */
+VectorIORequest* vector_load_async(const char *path, BOOL direct,
+		void (*callback)(VectorIORequest *request, BOOL ok, void *context), void *context);
+
+/**
+ * A file descriptor which polls readable (with poll, select or epoll) once a request has finished.
+ * It stays readable, so it can be watched by any number of event loops.
+ *
+ * @param request The request
+ * @return The file descriptor, owned by the request
+ */
+int vector_io_fd(VectorIORequest *request);
+
+/**
+ * Whether a request has finished, without blocking.
+ *
+ * @param request The request
+ * @return Whether it has finished
+ */
+BOOL vector_io_done(VectorIORequest *request);
+
+/**
+ * Blocks until a request has finished.
+ *
+ * @param request The request
+ * @return Whether it succeeded
+ */
+BOOL vector_io_wait(VectorIORequest *request);
+
+/**
+ * Blocks until a load has finished and takes the loaded vector, which the caller then owns.
+ *
+ * @param request The load request
+ * @return The loaded vector, or NULL if the load failed (or the vector was already taken)
+ */
+Vector* vector_io_take(VectorIORequest *request);
+
+/**
+ * Waits for a request to finish and frees it (along with a loaded vector which was never taken).
+ * Must not be called from the request's own callback.
+ *
+ * @param request The request
+ */
+void free_vector_io(VectorIORequest *request);
+
+/**
+ * Creates a new vector in a POSIX shared memory segment. Other processes open it with
+ * open_shared_vector (or open_shared_vector_fd) and use it in place instead of each loading a copy.
+ * The whole capacity is reserved up front, so no process ever has to remap the segment;
+ * memory is only used as pages are touched.
+ * Attached indexes (range index, zone map, bloom filter) are private to each process and are not
+ * kept up to date across processes.
+ *
+ * @param name The shm_open name of the segment (eg. "/prices"), or NULL for an anonymous memfd
+ *             to be shared through fork or over a Unix socket (see shared_vector_fd)
+ * @param elem_size The size of each element in the vector
+ * @param reserved The most elements the vector may ever hold
+ * @param locked Whether to put a process shared reader / writer lock in the segment (see lock_shared_vector)
+ * @return The generated vector, or NULL if the segment could not be created (or the name is taken)
+ */
+Vector* create_shared_vector(const char *name, size_t elem_size, size_t reserved, BOOL locked);
+
+/**
+ * Opens a shared memory vector created (by any process) with create_shared_vector,
+ * waiting briefly if it is still being created.
+ *
+ * @param name The shm_open name of the segment
+ * @param read_only Whether to open it read only (the lock can still be taken)
+ * @return The vector, or NULL if the segment does not exist, is invalid or was never finished being created
+ */
+Vector* open_shared_vector(const char *name, BOOL read_only);
+
+/**
+ * Opens a shared memory vector from a file descriptor of its segment (eg. a memfd received
+ * over a Unix socket), taking ownership of the file descriptor.
+ *
+ * @param fd The file descriptor, open for reading and writing
+ * @param read_only Whether to open it read only (the lock can still be taken)
+ * @return The vector, or NULL if the segment is invalid (fd is closed)
+ */
+Vector* open_shared_vector_fd(int fd, BOOL read_only);
+
+/**
+ * The file descriptor of a shared memory vector's segment, to pass to another process
+ * (which opens it with open_shared_vector_fd).
+ *
+ * @param vector The shared memory vector
+ * @return The file descriptor, owned by the vector, or -1 if it is not a shared memory vector
+ */
+int shared_vector_fd(Vector *vector);
+
+/**
+ * Removes the name of a shared memory vector. Processes which have it open keep using it,
+ * and the memory is released once the last of them frees it.
+ *
+ * @param name The shm_open name of the segment
+ * @return Whether the name was removed
+ */
+BOOL unlink_shared_vector(const char *name);
+
+/**
+ * Locks a shared memory vector (if it was created with a lock) and brings this process's view of it
+ * up to date with changes made by other processes. Call this before every use of the vector,
+ * and unlock_shared_vector after.
+ *
+ * @param vector The shared memory vector
+ * @param exclusive Whether to lock it for writing (otherwise for reading, alongside other readers)
+ */
+void lock_shared_vector(Vector *vector, BOOL exclusive);
+
+/**
+ * Unlocks a shared memory vector locked with lock_shared_vector.
+ *
+ * @param vector The shared memory vector
+ */
+void unlock_shared_vector(Vector *vector);
+
+/**
+ * Snapshots vectors to a file in the background, in the style of Redis' BGSAVE: the process forks,
+ * and the child writes the vectors as they were at the moment of the fork (from its copy on write
+ * view of memory) while the parent carries on modifying them. The parent only pauses for the fork.
+ * The snapshot is written to a temporary file and renamed into place (and the directory flushed),
+ * so path always holds a complete snapshot. Memory mapped vectors are not copied on write, so they are not point in time.
+ *
+ * @param vectors The vectors to save
+ * @param count The amount of vectors
+ * @param path The path of the snapshot file (the vectors one after another, see vector_load_snapshot)
+ * @return The save in progress, or NULL if the process could not fork
+ */
+BackgroundSave* vector_save_background(Vector **vectors, size_t count, const char *path);
+
+/**
+ * A file descriptor which polls readable (with poll, select or epoll) once a background save's
+ * child has exited. Call background_save_done then to collect the result.
+ *
+ * @param save The background save
+ * @return The file descriptor, owned by the save
+ */
+int background_save_fd(BackgroundSave *save);
+
+/**
+ * Whether a background save has finished, without blocking.
+ *
+ * @param save The background save
+ * @return Whether it has finished (see background_save_wait for whether it succeeded)
+ */
+BOOL background_save_done(BackgroundSave *save);
+
+/**
+ * Blocks until a background save has finished.
+ *
+ * @param save The background save
+ * @return Whether the snapshot was written
+ */
+BOOL background_save_wait(BackgroundSave *save);
+
+/**
+ * Waits for a background save to finish and frees it.
+ *
+ * @param save The background save
+ */
+void free_background_save(BackgroundSave *save);
+
+/**
+ * Loads the vectors of a snapshot written by vector_save_background.
+ *
+ * @param path The path of the snapshot file
+ * @param vectors Where to store the loaded vectors
+ * @param count The amount of vectors in the snapshot
+ * @return Whether all of them were loaded (if not, none are kept)
+ */
+BOOL vector_load_snapshot(const char *path, Vector **vectors, size_t count);
+
+/**
+ * Starts tracking which blocks of a vector change (through push_back, set_elem, remove_elem,
+ * swap_elems, sort_vector and everything else which calls vector_modified), so vector_save_delta
+ * can write only those. Every block starts clean: attach it right after saving the base file.
+ * Replaces any dirty tracking already attached.
+ *
+ * @param vector The vector
+ */
+void attach_dirty_map(Vector *vector);
+
+/**
+ * Detaches (and deallocates) the dirty tracking of a vector, if it has one.
+ *
+ * @param vector The vector
+ */
+void detach_dirty_map(Vector *vector);
+
+/**
+ * The amount of blocks of a vector changed since dirty tracking was attached or the last delta was saved.
+ *
+ * @param vector The vector with dirty tracking
+ * @return The amount of dirty blocks (within the current length)
+ */
+size_t dirty_block_count(Vector *vector);
+
+/**
+ * Saves only the blocks of a vector changed since dirty tracking was attached or the last delta was
+ * saved, as a delta file, and marks every block clean again. Applying the deltas in the order they
+ * were saved to the base file (see compact_vector_deltas) gives the vector as it is now.
+ *
+ * @param vector The vector with dirty tracking
+ * @param path The path of the delta file, which is replaced
+ * @return Whether the delta was saved (if not, the blocks stay dirty)
+ */
+BOOL vector_save_delta(Vector *vector, const char *path);
+
+/**
+ * Folds delta files (from vector_save_delta) into the base file they were saved against
+ * (from vector_save), in place, so the base holds the vector as of the last delta. Every delta is
+ * verified before the base is touched. The deltas can be deleted afterwards.
+ * The base file's checksum is cleared, since recomputing it would read the whole file.
+ *
+ * @param base_path The path of the base file
+ * @param delta_paths The paths of the delta files, in the order they were saved
+ * @param count The amount of delta files
+ * @return Whether the deltas were folded in
+ */
+BOOL compact_vector_deltas(const char *base_path, const char **delta_paths, size_t count);
+
+/**
+ * Opens a journaled vector: loads the base snapshot (if there is one), replays the log on top of it,
+ * and carries on logging to it. A torn record at the end of the log (from a crash mid write) is
+ * dropped along with everything after it; records which were committed are never lost.
+ *
+ * @param base_path The path of the base snapshot, which need not exist yet
+ * @param log_path The path of the log, which need not exist yet
+ * @param elem_size The size of each element in the vector
+ * @param commit_every The amount of records per group commit (1 to commit every operation, 0 to
+ *                     commit only on journal_commit)
+ * @param checkpoint_bytes The log size at which a commit also rolls the log into the base snapshot
+ *                         (0 to only checkpoint on journal_checkpoint)
+ * @return The journaled vector, or NULL if the files could not be opened or are invalid
+ */
+JournaledVector* open_journaled_vector(const char *base_path, const char *log_path, size_t elem_size,
+		size_t commit_every, size_t checkpoint_bytes);
+
+/**
+ * Pushes an element to the back of a journaled vector, and logs it.
+ *
+ * @param journaled The journaled vector
+ * @param element The element to push
+ * @return Whether it was applied (and the log could be written if a commit was due)
+ */
+BOOL journal_push_back(JournaledVector *journaled, void *element);
+
+/**
+ * Sets an element of a journaled vector, and logs it.
+ *
+ * @param journaled The journaled vector
+ * @param index The index of the element (0 <= index < length)
+ * @param element The data to set the element to
+ * @return Whether it was applied (FALSE for an index out of range, or if a due commit failed)
+ */
+BOOL journal_set_elem(JournaledVector *journaled, int index, void *element);
+
+/**
+ * Removes an element of a journaled vector (shifting the rest across), and logs it.
+ *
+ * @param journaled The journaled vector
+ * @param index The index of the element (0 <= index < length)
+ * @return Whether it was applied (FALSE for an index out of range, or if a due commit failed)
+ */
+BOOL journal_remove_elem(JournaledVector *journaled, int index);
+
+/**
+ * Swaps two elements of a journaled vector, and logs it.
+ *
+ * @param journaled The journaled vector
+ * @param index1 The first index
+ * @param index2 The second index
+ * @return Whether it was applied (FALSE for an index out of range, or if a due commit failed)
+ */
+BOOL journal_swap_elems(JournaledVector *journaled, int index1, int index2);
+
+/**
+ * Overwrites a range of elements of a journaled vector, and logs it as a single record.
+ *
+ * @param journaled The journaled vector
+ * @param index The first index to overwrite
+ * @param elements The elements to write
+ * @param count The amount of elements (index + count <= length)
+ * @return Whether it was applied (FALSE for a range out of bounds, or if a due commit failed)
+ */
+BOOL journal_set_range(JournaledVector *journaled, size_t index, void *elements, size_t count);
+
+/**
+ * Removes the elements in [from, to) of a journaled vector (shifting the rest across),
+ * and logs it as a single record.
+ *
+ * @param journaled The journaled vector
+ * @param from The first index to remove
+ * @param to One past the last index to remove (from <= to <= length)
+ * @return Whether it was applied (FALSE for a range out of bounds, or if a due commit failed)
+ */
+BOOL journal_remove_range(JournaledVector *journaled, size_t from, size_t to);
+
+/**
+ * Writes every pending record of a journaled vector to its log with one write, and makes them
+ * durable with one fdatasync. Rolls the log into the base snapshot if it has grown past checkpoint_bytes.
+ * If the commit fails, the log is cut back to the records committed before it.
+ *
+ * @param journaled The journaled vector
+ * @return Whether the records are durable (if not, they stay pending)
+ */
+BOOL journal_commit(JournaledVector *journaled);
+
+/**
+ * Rolls a journaled vector's log into its base snapshot: the vector is saved (to a temporary file,
+ * renamed into place, with the rename made durable) and only then is the log started afresh.
+ * A crash at any point leaves a base and log which open to the same vector.
+ *
+ * @param journaled The journaled vector
+ * @return Whether the checkpoint was taken
+ */
+BOOL journal_checkpoint(JournaledVector *journaled);
+
+/**
+ * Commits any pending records of a journaled vector and frees it (and its vector).
+ *
+ * @param journaled The journaled vector
+ */
+void free_journaled_vector(JournaledVector *journaled);
+
+/**
+ * Parses numbers separated by commas, newlines and/or other whitespace (eg. CSV of numbers) and appends
+ * them to a numeric vector, all at once. Numbers are converted with custom integer and decimal routines
+ * (falling back on strtod only for the rare numbers those cannot convert exactly), and large texts are
+ * split into chunks parsed in parallel. Vectors in sorted mode have the numbers merged in.
+ *
+ * @param vector The vector, whose elements are of the given type
+ * @param text The text (need not be NUL terminated)
+ * @param length The length of the text
+ * @param type The type of the numbers (integers may not have a fraction or exponent)
+ * @param threads The most threads to parse with (1 parses on the calling thread)
+ * @return Whether the whole text was valid (if not, nothing is appended)
+ */
+BOOL vector_parse_text(Vector *vector, const char *text, size_t length, NumericType type, int threads);
+
+/**
+ * Imports a text file of numbers separated by commas, newlines and/or other whitespace into a numeric
+ * vector (see vector_parse_text). The file is mapped into memory rather than read.
+ *
+ * @param vector The vector, whose elements are of the given type
+ * @param path The path of the file
+ * @param type The type of the numbers
+ * @param threads The most threads to parse with (1 parses on the calling thread)
+ * @return Whether the whole file was read and valid (if not, nothing is appended)
+ */
+BOOL vector_import_text(Vector *vector, const char *path, NumericType type, int threads);
+
+
+
+/**
+ * The nearest power of 2 from x upwards.
+ *
+ * @param x The number to operate on
+ * @return x if x is a power of 2, otherwise the next power of 2 greater than x
+ */
+int next_pow_2(int x) {
+	if (x <= 2) {
+		return 1;
+	}
+	double log2 = log(x) / log(2);
+	return (int) ceil(log2);
+}
+
+/**
+ * Create a new vector with default size 16
+ *
+ * @param elem_size The size of each element in the vector
+ * @return The generated vector
+ */
+Vector* create_vector(size_t elem_size) {
+	return create_vector_with_capacity(elem_size, 16);
+}
+
+/**
+ * Creates a new vector and fills it with initial_size default values of default_value.
+ *
+ * @param elem_size The size of each element in the vector
+ * @param initial_size The initial size to create the vector with default values
+ * @param default_value The default value to fill the vector with
+ * @return The generated vector
+ */
+Vector* create_vector_with_default(size_t elem_size, size_t initial_size, void *default_value) {
+	Vector *vector = create_vector_with_capacity(elem_size, initial_size);
+
+	for (int i = 0; i < initial_size; i++) {
+		push_back(vector, default_value);
+	}
+
+	return vector;
+}
+
+/**
+ * Creates a new vector with *at least* initial_size capacity (the next power of 2 for ease of management).
+ *
+ * @param elem_size The size of each element in the vector
+ * @param initial_size The capacity at which the vector will have a minimum of
+ * @return The generated vector
+ */
+Vector* create_vector_with_capacity(size_t elem_size, size_t initial_size) {
+	size_t actual_size = (size_t) pow(2, next_pow_2(initial_size));
+
+	void *array = calloc(actual_size, elem_size);
+
+	Vector *vector = malloc(sizeof(Vector));
+	vector->array = array;
+	vector->elem_size = elem_size;
+	vector->length = 0;
+	vector->capacity = actual_size;
+	vector->sorted_by = NULL;
+	vector->range_index = NULL;
+	vector->zone_map = NULL;
+	vector->bloom = NULL;
+	vector->dirty = NULL;
+	vector->mapping = NULL;
+
+	return vector;
+}
+
+/**
+ * Clones a vector into new memory.
+ *
+ * @param old The old vector to copy from
+ * @return The new copied vector
+ */
+Vector* clone(Vector* old) {
+	Vector *new = malloc(sizeof(Vector));
+	void *array = calloc(old->capacity, old->elem_size);
+
+	new->array = array;
+	new->elem_size = old->elem_size;
+	new->length = old->length;
+	new->capacity = old->capacity;
+	new->sorted_by = old->sorted_by;
+	new->range_index = NULL;
+	new->zone_map = NULL;
+	new->bloom = NULL;
+	new->dirty = NULL;
+	new->mapping = NULL;
+	memcpy(array, old->array, old->elem_size * old->length);
+
+	return new;
+}
+
+/**
+ * Gets the element at a specific index of the vector.
+ *
+ * @param vector The vector
+ * @param index The index to retrieve the element from
+ * @return The value as void*
+ */
+void* get_elem(Vector *vector, int index) {
+	return (void*) (vector->array + (index * vector->elem_size));
+}
+
+/**
+ * Sets an element at a particular index to a given value
+ *
+ * @param vector The vector
+ * @param index The index to set the element of
+ * @param element The data to set the element to
+ */
+void set_elem(Vector *vector, int index, void *element) {
+	if (!check_writable(vector, "set_elem")) {
+		return;
+	}
+
+	memcpy(vector->array + (index * vector->elem_size), element, vector->elem_size);
+	vector_modified(vector, index, index + 1);
+}
+
+/**
+ * Removes an element from a vector and shifts the rest of the vector across.
+ *
+ * @param vector The vector
+ * @param index The index of the item to remove
+ */
+void remove_elem(Vector *vector, int index) {
+	if (!check_writable(vector, "remove_elem")) {
+		return;
+	}
+
+	size_t old_length = vector->length;
+	void *slot = get_elem(vector, index);
+
+	memmove(slot, slot + vector->elem_size, (vector->length - index - 1) * vector->elem_size);
+	vector->length--;
+	vector_modified(vector, index, old_length);
+}
+
+/**
+ * Inserts an element at an index, shifting the rest of the vector across.
+ *
+ * @param vector The vector
+ * @param index The index to insert the element at (0 <= index <= length)
+ * @param element The element to insert
+ */
+void insert_elem(Vector *vector, int index, void *element) {
+	if (!check_writable(vector, "insert_elem")) {
+		return;
+	}
+
+	if (vector->length >= vector->capacity) {
+		expand_vector(vector, vector->capacity * 2);
+	}
+
+	void *slot = get_elem(vector, index);
+	memmove(slot + vector->elem_size, slot, (vector->length - index) * vector->elem_size);
+	memcpy(slot, element, vector->elem_size);
+	vector->length++;
+	vector_modified(vector, index, vector->length);
+}
+
+/**
+ * Searches a vector and returns the index of where a given element lies.
+ * Vectors with a Bloom filter return -1 straight away for elements it rules out.
+ * Vectors in sorted mode are binary searched, and vectors with a zone map skip
+ * every block which cannot hold the element.
+ *
+ * @param vector The vector to search
+ * @param element The data to search for
+ * @return The index of the found element, or -1 if it does not exist
+ */
+int index_of(Vector *vector, void *element) {
+	if (vector->bloom != NULL && !bloom_filter_may_contain(vector, element)) {
+		return -1;
+	}
+
+	if (vector->sorted_by != NULL) {
+		// Elements the comparator calls equal need not be identical in memory, so check the whole run
+		for (int i = lower_bound(vector, element, vector->sorted_by); i < vector->length; i++) {
+			void *candidate = get_elem(vector, i);
+			if (vector->sorted_by(candidate, element) != 0) {
+				break;
+			}
+			if (memcmp(candidate, element, vector->elem_size) == 0) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	if (vector->zone_map != NULL) {
+		return zone_map_index_of(vector, element);
+	}
+
+	for (int i = 0; i < vector->length; i++) {
+		void *candidate = get_elem(vector, i);
+		if (memcmp(candidate, element, vector->elem_size) == 0) { // memcmp returns 0 if memory is equal
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Whether a vector holds a given element.
+ *
+ * @param vector The vector to search
+ * @param element The data to search for
+ * @return Whether the element exists
+ */
+BOOL contains(Vector *vector, void *element) {
+	return index_of(vector, element) != -1;
+}
+
+/**
+ * Whether the vector is currently empty.
+ *
+ * @param vector The vector
+ * @return Whether it is empty
+ */
+BOOL is_empty(Vector *vector) {
+	return vector->length == 0;
+}
+
+/**
+ * Whether any elements are common between two vectors.
+ *
+ * @param vector1 The first vector
+ * @param vector2 The second vector
+ * @return Whether any elements are the same
+ */
+BOOL any_elems_shared(Vector *vector1, Vector *vector2) {
+	if (vector1->elem_size != vector2->elem_size) {
+		fprintf(stderr, "ERROR: Attempted to compare vectors with inequal element sizes!\n");
+		return FALSE;
+	}
+
+	for (int i = 0; i < vector1->length; i++) {
+		void *elem1 = get_elem(vector1, i);
+
+		for (int j = 0; j < vector2->length; j++) {
+			void *elem2 = get_elem(vector2, j);
+
+			if (memcmp(elem1, elem2, vector1->elem_size) == 0) { // memcmp returns 0 if memory is equal
+				return TRUE;
+			}
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * Swaps two elements in a vector from given indexes.
+ *
+ * @param vector The vector to perform the swap in
+ * @param index1 The first index
+ * @param index2 The second index
+ */
+void swap_elems(Vector *vector, int index1, int index2) {
+	if (!check_writable(vector, "swap_elems")) {
+		return;
+	}
+
+	if (index1 == index2) {
+		return;
+	}
+
+	void *elem1 = get_elem(vector, index1);
+	void *elem2 = get_elem(vector, index2);
+
+	void *temp = malloc(vector->elem_size);
+	memcpy(temp, elem1, vector->elem_size);
+
+	set_elem(vector, index1, elem2);
+	set_elem(vector, index2, temp);
+
+	free(temp);
+}
+
+/**
+ * Sorts a vector with a comparison function.
+ * Uses selection sort (O(n^2)).
+ * A vector in sorted mode by the same comparison is already in order, so this does nothing;
+ * sorting it by any other comparison switches it out of sorted mode.
+ *
+ * @param vector The vector to sort
+ * @param sort  The function pointer to compare two similar elements
+ *              (Return 1 if elem1 > elem2, 0 if elem1 == elem2, -1 if elem1 < elem2)
+ */
+void sort_vector(Vector *vector, int (*compare)(void *elem1, void *elem2)) {
+	if (!check_writable(vector, "sort_vector")) {
+		return;
+	}
+
+	if (vector->sorted_by == compare) {
+		return;
+	}
+	make_vector_unsorted(vector);
+
+	for (int i = 0; i < vector->length - 1; i++) {
+		int min_index = i;
+		void *min = get_elem(vector, i);
+
+		for (int j = i + 1; j < vector->length; j++) {
+			void *candidate = get_elem(vector, j);
+
+			int result = compare(min, candidate);
+
+			if (result == 1) {
+				min = candidate;
+				min_index = j;
+			}
+		}
+
+		swap_elems(vector, i, min_index);
+	}
+}
+
+/**
+ * Push an element to the back of the vector.
+ * Vectors in sorted mode insert the element at its sorted position instead.
+ *
+ * @param vector The vector
+ * @param element The element to insert
+ */
+void push_back(Vector *vector, void *element) {
+	if (!check_writable(vector, "push_back")) {
+		return;
+	}
+
+	if (vector->sorted_by != NULL) {
+		insert_sorted(vector, element);
+		return;
+	}
+
+	if (vector->length >= vector->capacity) {
+		expand_vector(vector, vector->capacity * 2);
+	}
+	memcpy(get_elem(vector, vector->length), element, vector->elem_size);
+	vector->length++;
+	vector_modified(vector, vector->length - 1, vector->length);
+}
+
+/**
+ * Expands a vector to a new capacity (retaining all current data)
+ *
+ * @param vector The vector
+ * @param new_size The size to expand the vector's capacity to
+ */
+void expand_vector(Vector *vector, size_t new_size) {
+	if (!check_writable(vector, "expand_vector")) {
+		return;
+	}
+
+	if (vector->mapping != NULL) {
+		expand_mapped_vector(vector, new_size);
+		return;
+	}
+
+	void *array = vector->array;
+
+	size_t new_bytes = vector->elem_size * new_size;
+
+	void *new_array = realloc(array, new_bytes);
+
+	if (new_array == NULL) { // PANIC!
+		fprintf(stderr, "ERROR: Vector expansion failed, possibly out of memory? Exiting...\n");
+		exit(1);
+		return;
+	}
+
+	vector->array = new_array;
+	vector->capacity = new_size;
+}
+
+/**
+ * Makes sure a vector can hold at least min_capacity elements without reallocating,
+ * doubling its capacity as many times as needed.
+ *
+ * @param vector The vector
+ * @param min_capacity The capacity the vector must have afterwards
+ * @return Whether the vector can now hold min_capacity elements (FALSE if it is read only or cannot grow)
+ */
+BOOL reserve_vector(Vector *vector, size_t min_capacity) {
+	if (min_capacity <= vector->capacity) {
+		return TRUE;
+	}
+
+	size_t new_capacity = MAX(vector->capacity, 1);
+	while (new_capacity < min_capacity) {
+		new_capacity *= 2;
+	}
+	expand_vector(vector, new_capacity);
+
+	// expand_vector only complains (and leaves the capacity alone) when it refuses
+	return vector->capacity >= min_capacity;
+}
+
+/**
+ * Binary searches a sorted vector for the first element not less than a given element.
+ *
+ * @param vector The vector, sorted by compare
+ * @param element The element to search for
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @return The index of the first element >= element, or length if there is none
+ */
+int lower_bound(Vector *vector, void *element, int (*compare)(void *elem1, void *elem2)) {
+	size_t low = 0;
+	size_t high = vector->length;
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (compare(get_elem(vector, mid), element) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * Binary searches a sorted vector for the first element greater than a given element.
+ *
+ * @param vector The vector, sorted by compare
+ * @param element The element to search for
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @return The index of the first element > element, or length if there is none
+ */
+int upper_bound(Vector *vector, void *element, int (*compare)(void *elem1, void *elem2)) {
+	size_t low = 0;
+	size_t high = vector->length;
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (compare(get_elem(vector, mid), element) <= 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * Stable merge sort of a raw array of elements (O(n log n)).
+ *
+ * @param array The elements to sort
+ * @param count The amount of elements
+ * @param elem_size The size (in bytes) of each element
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+static void merge_sort_elems(void *array, size_t count, size_t elem_size, int (*compare)(void *elem1, void *elem2)) {
+	if (count < 2) {
+		return;
+	}
+
+	void *scratch = malloc(count * elem_size);
+	void *from = array;
+	void *to = scratch;
+
+	// Bottom up: merge runs of width 1, 2, 4, ... back and forth between the two buffers
+	for (size_t width = 1; width < count; width *= 2) {
+		for (size_t start = 0; start < count; start += 2 * width) {
+			size_t middle = MIN(start + width, count);
+			size_t end = MIN(start + 2 * width, count);
+			size_t i = start;
+			size_t j = middle;
+			size_t k = start;
+
+			while (i < middle && j < end) {
+				if (compare(from + j * elem_size, from + i * elem_size) < 0) {
+					memcpy(to + k++ * elem_size, from + j++ * elem_size, elem_size);
+				} else {
+					memcpy(to + k++ * elem_size, from + i++ * elem_size, elem_size);
+				}
+			}
+			memcpy(to + k * elem_size, from + i * elem_size, (middle - i) * elem_size);
+			k += middle - i;
+			memcpy(to + k * elem_size, from + j * elem_size, (end - j) * elem_size);
+		}
+
+		void *temp = from;
+		from = to;
+		to = temp;
+	}
+
+	if (from != array) {
+		memcpy(array, from, count * elem_size);
+	}
+	free(scratch);
+}
+
+/**
+ * Switches a vector into sorted mode: it is sorted once now and kept sorted by compare from then on.
+ * While in sorted mode, set_elem, insert_elem and swap_elems must not be used to break the order.
+ *
+ * @param vector The vector
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+void make_vector_sorted(Vector *vector, int (*compare)(void *elem1, void *elem2)) {
+	if (!check_writable(vector, "make_vector_sorted")) {
+		return;
+	}
+
+	merge_sort_elems(vector->array, vector->length, vector->elem_size, compare);
+	vector->sorted_by = compare;
+	vector_modified(vector, 0, vector->length);
+}
+
+/**
+ * Switches a vector out of sorted mode (its elements stay where they are).
+ *
+ * @param vector The vector
+ */
+void make_vector_unsorted(Vector *vector) {
+	vector->sorted_by = NULL;
+}
+
+/**
+ * Inserts an element into a vector in sorted mode at its sorted position (after any equal elements).
+ * Uses a binary search and a single memmove.
+ *
+ * @param vector The vector in sorted mode
+ * @param element The element to insert
+ * @return The index the element was inserted at
+ */
+int insert_sorted(Vector *vector, void *element) {
+	if (!check_writable(vector, "insert_sorted")) {
+		return -1;
+	}
+
+	if (vector->sorted_by == NULL) {
+		fprintf(stderr, "ERROR: Attempted a sorted insert into a vector which is not in sorted mode!\n");
+		return -1;
+	}
+
+	int index = upper_bound(vector, element, vector->sorted_by);
+	insert_elem(vector, index, element);
+	return index;
+}
+
+/**
+ * Inserts a batch of elements into a vector already sorted by compare, keeping it sorted.
+ * The batch is sorted, the vector grown once, and the two merged from the back into the free tail,
+ * galloping (exponential then binary search) to find where each batch element lands so that runs
+ * of the vector are moved with one memmove each (O(n + k log k)).
+ * Batch elements are placed after any equal elements already in the vector.
+ *
+ * @param vector The vector, sorted by compare
+ * @param batch The vector of elements to insert (left untouched)
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+void merge_insert_sorted(Vector *vector, Vector *batch, int (*compare)(void *elem1, void *elem2)) {
+	if (!check_writable(vector, "merge_insert_sorted")) {
+		return;
+	}
+
+	if (vector->elem_size != batch->elem_size) {
+		fprintf(stderr, "ERROR: Attempted to merge vectors with inequal element sizes!\n");
+		return;
+	}
+
+	size_t elem_size = vector->elem_size;
+	size_t count = batch->length;
+	void *sorted = malloc(count * elem_size + 1);
+	memcpy(sorted, batch->array, count * elem_size);
+	merge_sort_elems(sorted, count, elem_size, compare);
+
+	if (!reserve_vector(vector, vector->length + count)) {
+		free(sorted);
+		return;
+	}
+
+	size_t end = vector->length; // vector[0, end) has not been moved yet
+	for (size_t j = count; j > 0; j--) {
+		void *element = sorted + (j - 1) * elem_size;
+
+		// Gallop backwards from end for the first element greater than this batch element
+		size_t step = 1;
+		size_t high = end;
+		while (step <= high && compare(get_elem(vector, high - step), element) > 0) {
+			high -= step;
+			step *= 2;
+		}
+		size_t low = step <= high ? high - step + 1 : 0;
+		while (low < high) {
+			size_t mid = low + (high - low) / 2;
+			if (compare(get_elem(vector, mid), element) > 0) {
+				high = mid;
+			} else {
+				low = mid + 1;
+			}
+		}
+
+		// Everything in [low, end) is greater, so it shifts up past the j batch elements still to place
+		void *run = get_elem(vector, low);
+		memmove(run + j * elem_size, run, (end - low) * elem_size);
+		memcpy(run + (j - 1) * elem_size, element, elem_size);
+		end = low;
+	}
+
+	vector->length += count;
+	vector_modified(vector, end, vector->length);
+	free(sorted);
+}
+
+/**
+ * Memory management: Deallocate a vector.
+ *
+ * @param vector The vector to deallocate
+ */
+void free_vector(Vector *vector) {
+    detach_range_index(vector);
+    detach_zone_map(vector);
+    detach_bloom_filter(vector);
+    detach_dirty_map(vector);
+    if (vector->mapping != NULL) {
+        unmap_vector(vector);
+    } else {
+        free(vector->array);
+    }
+    free(vector);
+}
+
+/**
+ * Notifies everything attached to a vector that the elements in [from, to) changed and/or
+ * that its length changed. Every vector function calls this itself; it is only needed
+ * after writing to vector->array or vector->length directly.
+ *
+ * @param vector The vector
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void vector_modified(Vector *vector, size_t from, size_t to) {
+	if (vector->range_index != NULL) {
+		range_index_update(vector, from, to);
+	}
+	if (vector->zone_map != NULL) {
+		zone_map_update(vector, from, to);
+	}
+	if (vector->bloom != NULL) {
+		bloom_filter_update(vector, from, to);
+	}
+	if (vector->dirty != NULL) {
+		dirty_map_update(vector, from, to);
+	}
+	if (vector->mapping != NULL && !vector->mapping->read_only) {
+		((VectorFileHeader*) vector->mapping->base)->length = vector->length;
+	}
+}
+
+/**
+ * Reads an element of a numeric type as a double.
+ *
+ * @param type The type of the element
+ * @param element The element
+ * @return The value of the element
+ */
+double numeric_value(NumericType type, void *element) {
+	switch (type) {
+		case NUMERIC_INT:
+			return *(int*) element;
+		case NUMERIC_LONG:
+			return *(long long*) element;
+		case NUMERIC_FLOAT:
+			return *(float*) element;
+		case NUMERIC_DOUBLE:
+		default:
+			return *(double*) element;
+	}
+}
+
+/**
+ * Whether a vector is read only (see open_readonly_vector).
+ *
+ * @param vector The vector
+ * @return Whether it may not be modified
+ */
+BOOL is_read_only(Vector *vector) {
+	return vector->mapping != NULL && vector->mapping->read_only;
+}
+
+/**
+ * Complains if a vector is read only. Every mutating vector function checks this first.
+ *
+ * @param vector The vector
+ * @param function The name of the function attempting to modify the vector
+ * @return Whether the vector may be modified
+ */
+BOOL check_writable(Vector *vector, const char *function) {
+	if (is_read_only(vector)) {
+		fprintf(stderr, "ERROR: %s attempted to modify a read only vector!\n", function);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * A 64 bit hash of some bytes, mixed a word at a time.
+ *
+ * @param data The bytes to hash
+ * @param length The amount of bytes
+ * @return The hash
+ */
+unsigned long long hash_bytes(const void *data, size_t length) {
+	const unsigned char *bytes = data;
+	unsigned long long hash = 0x9E3779B97F4A7C15ULL ^ (length * 0xC2B2AE3D27D4EB4FULL);
+
+	while (length >= 8) {
+		unsigned long long word;
+		memcpy(&word, bytes, 8);
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+		hash ^= hash >> 32;
+		bytes += 8;
+		length -= 8;
+	}
+
+	if (length > 0) {
+		unsigned long long word = 0;
+		memcpy(&word, bytes, length);
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+	}
+
+	// splitmix64 finalizer
+	hash ^= hash >> 30;
+	hash *= 0xBF58476D1CE4E5B9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94D049BB133111EBULL;
+	hash ^= hash >> 31;
+	return hash;
+}
+
+/**
+ * The size (in bytes) of an element of a numeric type.
+ *
+ * @param type The type
+ * @return The size of the type
+ */
+size_t numeric_size(NumericType type) {
+	switch (type) {
+		case NUMERIC_INT:
+			return sizeof(int);
+		case NUMERIC_LONG:
+			return sizeof(long long);
+		case NUMERIC_FLOAT:
+			return sizeof(float);
+		case NUMERIC_DOUBLE:
+		default:
+			return sizeof(double);
+	}
+}
+
+/**
+ * Finds where a logical index lives (or would live) in a sparse vector's stored pairs.
+ *
+ * @param sparse The sparse vector
+ * @param index The logical index to look for
+ * @param found Set to whether the index is currently populated
+ * @return The position within sparse->indexes of the index, or where it should be inserted
+ */
+static int sparse_find(SparseVector *sparse, size_t index, BOOL *found) {
+	size_t *indexes = sparse->indexes->array;
+	size_t count = sparse->indexes->length;
+
+	// Fast path: writes usually land at (or past) the end
+	if (count == 0 || indexes[count - 1] < index) {
+		*found = FALSE;
+		return count;
+	}
+
+	size_t low = 0;
+	size_t high = count;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (indexes[mid] < index) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	*found = low < count && indexes[low] == index;
+	return low;
+}
+
+/**
+ * Creates a new sparse vector of a given logical length where every element is default_value.
+ *
+ * @param elem_size The size of each element in the vector
+ * @param length The logical length of the sparse vector
+ * @param default_value The value every index holds until it is set
+ * @return The generated sparse vector
+ */
+SparseVector* create_sparse_vector(size_t elem_size, size_t length, void *default_value) {
+	SparseVector *sparse = malloc(sizeof(SparseVector));
+	sparse->indexes = create_vector(sizeof(size_t));
+	sparse->elements = create_vector(elem_size);
+	sparse->default_value = malloc(elem_size);
+	memcpy(sparse->default_value, default_value, elem_size);
+	sparse->elem_size = elem_size;
+	sparse->length = length;
+
+	return sparse;
+}
+
+/**
+ * Gets the element at a specific index of the sparse vector.
+ *
+ * @param sparse The sparse vector
+ * @param index The index to retrieve the element from
+ * @return The stored value, or the default value if the index has not been set
+ */
+void* sparse_get_elem(SparseVector *sparse, size_t index) {
+	BOOL found;
+	int position = sparse_find(sparse, index, &found);
+
+	if (!found) {
+		return sparse->default_value;
+	}
+	return get_elem(sparse->elements, position);
+}
+
+/**
+ * Sets an element at a particular index of the sparse vector.
+ * Setting an index back to the default value releases its storage.
+ *
+ * @param sparse The sparse vector
+ * @param index The index to set the element of
+ * @param element The data to set the element to
+ */
+void sparse_set_elem(SparseVector *sparse, size_t index, void *element) {
+	if (index >= sparse->length) {
+		fprintf(stderr, "ERROR: Attempted to set sparse vector index %zu beyond length %zu!\n", index, sparse->length);
+		return;
+	}
+
+	BOOL found;
+	int position = sparse_find(sparse, index, &found);
+	BOOL is_default = memcmp(element, sparse->default_value, sparse->elem_size) == 0;
+
+	if (found) {
+		if (is_default) {
+			remove_elem(sparse->indexes, position);
+			remove_elem(sparse->elements, position);
+		} else {
+			set_elem(sparse->elements, position, element);
+		}
+	} else if (!is_default) {
+		insert_elem(sparse->indexes, position, &index);
+		insert_elem(sparse->elements, position, element);
+	}
+}
+
+/**
+ * Push an element to the back of the sparse vector.
+ *
+ * @param sparse The sparse vector
+ * @param element The element to insert
+ */
+void sparse_push_back(SparseVector *sparse, void *element) {
+	sparse->length++;
+	sparse_set_elem(sparse, sparse->length - 1, element);
+}
+
+/**
+ * The amount of elements actually stored (ie. those which differ from the default value).
+ *
+ * @param sparse The sparse vector
+ * @return The populated element count
+ */
+size_t sparse_populated_count(SparseVector *sparse) {
+	return sparse->indexes->length;
+}
+
+/**
+ * Iterates over the populated elements of a sparse vector in ascending index order.
+ *
+ * @param sparse The sparse vector
+ * @param visit The function pointer called with each populated index and element
+ * @param context Passed through untouched to every call of visit
+ */
+void sparse_for_each(SparseVector *sparse, void (*visit)(size_t index, void *element, void *context), void *context) {
+	size_t *indexes = sparse->indexes->array;
+
+	for (int i = 0; i < sparse->indexes->length; i++) {
+		visit(indexes[i], get_elem(sparse->elements, i), context);
+	}
+}
+
+/**
+ * Expands a sparse vector into a regular (dense) vector.
+ *
+ * @param sparse The sparse vector
+ * @return A new vector holding every logical element of the sparse vector
+ */
+Vector* sparse_to_vector(SparseVector *sparse) {
+	Vector *vector = create_vector_with_default(sparse->elem_size, sparse->length, sparse->default_value);
+	size_t *indexes = sparse->indexes->array;
+
+	for (int i = 0; i < sparse->indexes->length; i++) {
+		set_elem(vector, indexes[i], get_elem(sparse->elements, i));
+	}
+
+	return vector;
+}
+
+/**
+ * Memory management: Deallocate a sparse vector.
+ *
+ * @param sparse The sparse vector to deallocate
+ */
+void free_sparse_vector(SparseVector *sparse) {
+	free_vector(sparse->indexes);
+	free_vector(sparse->elements);
+	free(sparse->default_value);
+	free(sparse);
+}
+
+/**
+ * Create a new, empty string vector.
+ *
+ * @return The generated string vector
+ */
+StringVector* create_string_vector() {
+	StringVector *strings = malloc(sizeof(StringVector));
+	size_t zero = 0;
+
+	strings->blob = create_vector_with_capacity(sizeof(char), 256);
+	strings->offsets = create_vector(sizeof(size_t));
+	strings->length = 0;
+	push_back(strings->offsets, &zero);
+
+	return strings;
+}
+
+/**
+ * Push a string to the back of the string vector (the bytes are copied into the blob).
+ *
+ * @param strings The string vector
+ * @param string The bytes of the string (need not be NUL terminated)
+ * @param length The amount of bytes in the string
+ */
+void string_push_back(StringVector *strings, const char *string, size_t length) {
+	Vector *blob = strings->blob;
+	size_t end = blob->length + length;
+
+	if (end > blob->capacity) {
+		size_t new_capacity = blob->capacity;
+		while (new_capacity < end) {
+			new_capacity *= 2;
+		}
+		expand_vector(blob, new_capacity);
+	}
+
+	memcpy(blob->array + blob->length, string, length);
+	blob->length = end;
+	push_back(strings->offsets, &end);
+	strings->length++;
+}
+
+/**
+ * Gets the string at a specific index without copying it.
+ * The returned pointer is invalidated by the next push_back or sort.
+ *
+ * @param strings The string vector
+ * @param index The index to retrieve the string from
+ * @param length Set to the amount of bytes in the string (may be NULL)
+ * @return A pointer to the first byte of the string (not NUL terminated)
+ */
+const char* string_get_elem(StringVector *strings, int index, size_t *length) {
+	size_t *offsets = strings->offsets->array;
+
+	if (length != NULL) {
+		*length = offsets[index + 1] - offsets[index];
+	}
+	return (const char*) strings->blob->array + offsets[index];
+}
+
+/**
+ * Reads the first (up to) 8 bytes of a string as one word, zero padded.
+ *
+ * @param string The bytes of the string
+ * @param length The amount of bytes in the string
+ * @return The prefix word
+ */
+static unsigned long long string_prefix(const char *string, size_t length) {
+	unsigned long long prefix = 0;
+	memcpy(&prefix, string, length < sizeof(prefix) ? length : sizeof(prefix));
+	return prefix;
+}
+
+/**
+ * Searches a string vector and returns the index of where a given string lies.
+ *
+ * @param strings The string vector to search
+ * @param string The bytes to search for
+ * @param length The amount of bytes in the string
+ * @return The index of the found string, or -1 if it does not exist
+ */
+int string_index_of(StringVector *strings, const char *string, size_t length) {
+	size_t *offsets = strings->offsets->array;
+	const char *blob = strings->blob->array;
+	unsigned long long prefix = string_prefix(string, length);
+
+	// Reject on length, then on an 8 byte prefix word, before ever calling memcmp
+	for (int i = 0; i < strings->length; i++) {
+		if (offsets[i + 1] - offsets[i] != length) {
+			continue;
+		}
+
+		const char *candidate = blob + offsets[i];
+		if (string_prefix(candidate, length) != prefix) {
+			continue;
+		}
+
+		if (length <= sizeof(prefix) || memcmp(candidate, string, length) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * The byte of a string at a given depth, or -1 past its end.
+ *
+ * @param strings The string vector
+ * @param index The index of the string
+ * @param depth The byte position to read
+ * @return The byte (0 - 255), or -1 if the string is not that long
+ */
+static int string_byte_at(StringVector *strings, int index, size_t depth) {
+	size_t *offsets = strings->offsets->array;
+
+	if (offsets[index] + depth >= offsets[index + 1]) {
+		return -1;
+	}
+	return ((unsigned char*) strings->blob->array)[offsets[index] + depth];
+}
+
+/**
+ * Multikey quicksort (Bentley & Sedgewick) of an array of string indexes.
+ *
+ * @param strings The string vector the indexes refer to
+ * @param order The string indexes to sort
+ * @param count The amount of indexes
+ * @param depth The amount of leading bytes already known to be equal
+ */
+static void string_multikey_sort(StringVector *strings, int *order, size_t count, size_t depth) {
+	while (count > 1) {
+		int pivot = string_byte_at(strings, order[count / 2], depth);
+
+		// Three way partition on the byte at depth: [less | equal | greater]
+		size_t less = 0;
+		size_t i = 0;
+		size_t greater = count;
+		while (i < greater) {
+			int byte = string_byte_at(strings, order[i], depth);
+			if (byte < pivot) {
+				int temp = order[less];
+				order[less++] = order[i];
+				order[i++] = temp;
+			} else if (byte > pivot) {
+				int temp = order[--greater];
+				order[greater] = order[i];
+				order[i] = temp;
+			} else {
+				i++;
+			}
+		}
+
+		string_multikey_sort(strings, order, less, depth);
+		string_multikey_sort(strings, order + greater, count - greater, depth);
+
+		// Strings equal on every byte so far which have ended are fully sorted
+		if (pivot == -1) {
+			return;
+		}
+		order += less;
+		count = greater - less;
+		depth++;
+	}
+}
+
+/**
+ * Sorts a string vector bytewise (shorter strings first on a common prefix).
+ * Uses multikey quicksort (O(n log n + total distinguishing prefix bytes)),
+ * then rewrites the blob in sorted order so neighbouring strings stay adjacent in memory.
+ *
+ * @param strings The string vector to sort
+ */
+void sort_string_vector(StringVector *strings) {
+	if (strings->length < 2) {
+		return;
+	}
+
+	int *order = malloc(strings->length * sizeof(int));
+	for (int i = 0; i < strings->length; i++) {
+		order[i] = i;
+	}
+	string_multikey_sort(strings, order, strings->length, 0);
+
+	Vector *old_blob = strings->blob;
+	Vector *old_offsets = strings->offsets;
+	size_t *offsets = old_offsets->array;
+
+	strings->blob = create_vector_with_capacity(sizeof(char), old_blob->capacity);
+	strings->offsets = create_vector_with_capacity(sizeof(size_t), old_offsets->capacity);
+	strings->length = 0;
+	size_t zero = 0;
+	push_back(strings->offsets, &zero);
+
+	for (int i = 0; i < old_offsets->length - 1; i++) {
+		int index = order[i];
+		string_push_back(strings, old_blob->array + offsets[index], offsets[index + 1] - offsets[index]);
+	}
+
+	free(order);
+	free_vector(old_blob);
+	free_vector(old_offsets);
+}
+
+/**
+ * Memory management: Deallocate a string vector.
+ *
+ * @param strings The string vector to deallocate
+ */
+void free_string_vector(StringVector *strings) {
+	free_vector(strings->blob);
+	free_vector(strings->offsets);
+	free(strings);
+}
+
+/**
+ * Create a new, empty jagged vector ready for building.
+ *
+ * @param elem_size The size of each element in the vector
+ * @param rows The initial amount of (empty) rows
+ * @return The generated jagged vector
+ */
+JaggedVector* create_jagged_vector(size_t elem_size, size_t rows) {
+	JaggedVector *jagged = malloc(sizeof(JaggedVector));
+	jagged->values = create_vector(elem_size);
+	jagged->offsets = NULL;
+	jagged->pending_rows = create_vector(sizeof(size_t));
+	jagged->elem_size = elem_size;
+	jagged->rows = rows;
+	jagged->in_row_order = TRUE;
+	jagged->finalized = FALSE;
+
+	return jagged;
+}
+
+/**
+ * Push an element to the back of a row while building a jagged vector.
+ * Pushing to a row past the end grows the jagged vector to include it.
+ *
+ * @param jagged The jagged vector
+ * @param row The row to append to
+ * @param element The element to insert
+ */
+void jagged_row_push(JaggedVector *jagged, size_t row, void *element) {
+	if (jagged->finalized) {
+		fprintf(stderr, "ERROR: Attempted to push to an already finalized jagged vector!\n");
+		return;
+	}
+
+	Vector *pending_rows = jagged->pending_rows;
+	if (pending_rows->length > 0 && ((size_t*) pending_rows->array)[pending_rows->length - 1] > row) {
+		jagged->in_row_order = FALSE;
+	}
+	if (row >= jagged->rows) {
+		jagged->rows = row + 1;
+	}
+
+	push_back(pending_rows, &row);
+	push_back(jagged->values, element);
+}
+
+/**
+ * Finishes building a jagged vector, compacting every row contiguously in a single pass.
+ * No more elements may be pushed afterwards.
+ *
+ * @param jagged The jagged vector
+ */
+void finalize_jagged_vector(JaggedVector *jagged) {
+	if (jagged->finalized) {
+		return;
+	}
+
+	size_t count = jagged->values->length;
+	size_t *rows = jagged->pending_rows->array;
+
+	// Count the elements of each row into offsets[row + 1], then prefix sum into row starts
+	Vector *offsets = create_vector_with_capacity(sizeof(size_t), jagged->rows + 1);
+	size_t *starts = offsets->array;
+	memset(starts, 0, (jagged->rows + 1) * sizeof(size_t));
+	offsets->length = jagged->rows + 1;
+
+	for (size_t i = 0; i < count; i++) {
+		starts[rows[i] + 1]++;
+	}
+	for (size_t r = 0; r < jagged->rows; r++) {
+		starts[r + 1] += starts[r];
+	}
+
+	// Values pushed row by row are already in place, otherwise scatter them once
+	if (!jagged->in_row_order) {
+		Vector *values = create_vector_with_capacity(jagged->elem_size, count);
+		size_t *cursor = malloc((jagged->rows + 1) * sizeof(size_t));
+		memcpy(cursor, starts, (jagged->rows + 1) * sizeof(size_t));
+
+		for (size_t i = 0; i < count; i++) {
+			set_elem(values, cursor[rows[i]]++, get_elem(jagged->values, i));
+		}
+		values->length = count;
+
+		free(cursor);
+		free_vector(jagged->values);
+		jagged->values = values;
+	}
+
+	free_vector(jagged->pending_rows);
+	jagged->pending_rows = NULL;
+	jagged->offsets = offsets;
+	jagged->finalized = TRUE;
+}
+
+/**
+ * Gets a row of a finalized jagged vector without copying it.
+ *
+ * @param jagged The jagged vector
+ * @param row The row to retrieve
+ * @param length Set to the amount of elements in the row (may be NULL)
+ * @return A pointer to the first element of the row
+ */
+void* jagged_get_row(JaggedVector *jagged, size_t row, size_t *length) {
+	if (!jagged->finalized) {
+		fprintf(stderr, "ERROR: Attempted to read a row of a jagged vector before finalizing it!\n");
+		return NULL;
+	}
+
+	size_t *offsets = jagged->offsets->array;
+	if (length != NULL) {
+		*length = offsets[row + 1] - offsets[row];
+	}
+	return get_elem(jagged->values, offsets[row]);
+}
+
+/**
+ * Gets a single element of a finalized jagged vector.
+ *
+ * @param jagged The jagged vector
+ * @param row The row of the element
+ * @param column The position of the element within its row
+ * @return The value as void*
+ */
+void* jagged_get_elem(JaggedVector *jagged, size_t row, size_t column) {
+	void *start = jagged_get_row(jagged, row, NULL);
+	if (start == NULL) {
+		return NULL;
+	}
+	return start + column * jagged->elem_size;
+}
+
+/**
+ * Memory management: Deallocate a jagged vector.
+ *
+ * @param jagged The jagged vector to deallocate
+ */
+void free_jagged_vector(JaggedVector *jagged) {
+	free_vector(jagged->values);
+	if (jagged->offsets != NULL) {
+		free_vector(jagged->offsets);
+	}
+	if (jagged->pending_rows != NULL) {
+		free_vector(jagged->pending_rows);
+	}
+	free(jagged);
+}
+
+/**
+ * Creates a row-major matrix view over a vector.
+ *
+ * @param vector The vector holding at least rows * columns elements
+ * @param rows The amount of rows
+ * @param columns The amount of columns
+ * @return The matrix view, or an empty (0 x 0) view if the vector is too small
+ */
+MatrixView matrix_view(Vector *vector, size_t rows, size_t columns) {
+	if ((columns != 0 && rows > SIZE_MAX / columns) || rows * columns > vector->length) {
+		fprintf(stderr, "ERROR: Matrix view of %zu x %zu is larger than the vector!\n", rows, columns);
+		rows = 0;
+		columns = 0;
+	}
+
+	MatrixView matrix = { vector, rows, columns, 0, columns, 1 };
+	return matrix;
+}
+
+/**
+ * A view of the transpose of a matrix (only the strides are swapped, nothing is moved).
+ *
+ * @param matrix The matrix view
+ * @return The transposed matrix view
+ */
+MatrixView matrix_transpose_view(MatrixView matrix) {
+	MatrixView transposed = {
+		matrix.vector, matrix.columns, matrix.rows,
+		matrix.offset, matrix.column_stride, matrix.row_stride
+	};
+	return transposed;
+}
+
+/**
+ * Gets the element at a specific row and column of a matrix view.
+ *
+ * @param matrix The matrix view
+ * @param row The row of the element
+ * @param column The column of the element
+ * @return The value as void*
+ */
+void* matrix_get_elem(MatrixView matrix, size_t row, size_t column) {
+	// Not through get_elem, whose int index would truncate past 2^31 elements
+	size_t index = matrix.offset + row * matrix.row_stride + column * matrix.column_stride;
+	return matrix.vector->array + index * matrix.vector->elem_size;
+}
+
+/**
+ * Whether the elements two matrix views span (first to last, in memory) overlap.
+ *
+ * @param matrix1 The first matrix view
+ * @param matrix2 The second matrix view
+ * @return Whether they may share elements
+ */
+static BOOL matrix_views_overlap(MatrixView matrix1, MatrixView matrix2) {
+	if (matrix1.rows == 0 || matrix1.columns == 0 || matrix2.rows == 0 || matrix2.columns == 0) {
+		return FALSE;
+	}
+
+	char *start1 = matrix_get_elem(matrix1, 0, 0);
+	char *end1 = (char*) matrix_get_elem(matrix1, matrix1.rows - 1, matrix1.columns - 1) + matrix1.vector->elem_size;
+	char *start2 = matrix_get_elem(matrix2, 0, 0);
+	char *end2 = (char*) matrix_get_elem(matrix2, matrix2.rows - 1, matrix2.columns - 1) + matrix2.vector->elem_size;
+	return start1 < end2 && start2 < end1;
+}
+
+/**
+ * Copies the transpose of a matrix into another matrix, one cache sized block at a time.
+ * A square matrix may be transposed in place by passing the same view twice; otherwise
+ * the two views may not overlap.
+ *
+ * @param source The matrix view to transpose (rows x columns)
+ * @param destination The matrix view to write into (columns x rows)
+ */
+void matrix_transpose(MatrixView source, MatrixView destination) {
+	if (!check_writable(destination.vector, "matrix_transpose")) {
+		return;
+	}
+	if (source.rows != destination.columns || source.columns != destination.rows
+			|| source.vector->elem_size != destination.vector->elem_size) {
+		fprintf(stderr, "ERROR: Attempted to transpose into a matrix of the wrong shape!\n");
+		return;
+	}
+
+	size_t elem_size = source.vector->elem_size;
+	BOOL in_place = source.vector == destination.vector && source.offset == destination.offset
+			&& source.row_stride == destination.row_stride && source.column_stride == destination.column_stride;
+
+	if (in_place) {
+		// Square (the shapes matched), so swap each element above the diagonal with its mirror
+		char *temp = malloc(elem_size);
+		for (size_t i = 0; i < source.rows; i++) {
+			for (size_t j = i + 1; j < source.columns; j++) {
+				memcpy(temp, matrix_get_elem(source, i, j), elem_size);
+				memcpy(matrix_get_elem(source, i, j), matrix_get_elem(source, j, i), elem_size);
+				memcpy(matrix_get_elem(source, j, i), temp, elem_size);
+			}
+		}
+		free(temp);
+		vector_modified(destination.vector, 0, destination.vector->length);
+		return;
+	}
+	if (matrix_views_overlap(source, destination)) {
+		fprintf(stderr, "ERROR: matrix_transpose attempted to write its result over its source!\n");
+		return;
+	}
+
+	for (size_t i0 = 0; i0 < source.rows; i0 += MATRIX_BLOCK_SIZE) {
+		size_t i_end = MIN(i0 + MATRIX_BLOCK_SIZE, source.rows);
+
+		for (size_t j0 = 0; j0 < source.columns; j0 += MATRIX_BLOCK_SIZE) {
+			size_t j_end = MIN(j0 + MATRIX_BLOCK_SIZE, source.columns);
+
+			for (size_t i = i0; i < i_end; i++) {
+				for (size_t j = j0; j < j_end; j++) {
+					memcpy(matrix_get_elem(destination, j, i), matrix_get_elem(source, i, j), elem_size);
+				}
+			}
+		}
+	}
+
+	vector_modified(destination.vector, 0, destination.vector->length);
+}
+
+/**
+ * Checks the arguments of a matrix multiply and zeroes the result, complaining if they are unusable.
+ * The result is accumulated in place, so it may not overlap either input.
+ *
+ * @param left The left matrix view (n x k)
+ * @param right The right matrix view (k x m)
+ * @param result The matrix view to write into (n x m)
+ * @param elem_size The size of the element type being multiplied
+ * @param function_name The name of the multiply, for the error message
+ * @return Whether the multiply can go ahead
+ */
+static BOOL matrix_multiply_prepare(MatrixView left, MatrixView right, MatrixView result, size_t elem_size,
+		const char *function_name) {
+	if (!check_writable(result.vector, function_name)) {
+		return FALSE;
+	}
+	if (left.columns != right.rows || result.rows != left.rows || result.columns != right.columns) {
+		fprintf(stderr, "ERROR: Attempted to multiply matrices with mismatched dimensions!\n");
+		return FALSE;
+	}
+	if (left.vector->elem_size != elem_size || right.vector->elem_size != elem_size
+			|| result.vector->elem_size != elem_size) {
+		fprintf(stderr, "ERROR: %s attempted to multiply matrices of the wrong element type!\n", function_name);
+		return FALSE;
+	}
+	if (matrix_views_overlap(result, left) || matrix_views_overlap(result, right)) {
+		fprintf(stderr, "ERROR: %s attempted to write its result over one of its inputs!\n", function_name);
+		return FALSE;
+	}
+
+	for (size_t i = 0; i < result.rows; i++) {
+		for (size_t j = 0; j < result.columns; j++) {
+			memset(matrix_get_elem(result, i, j), 0, elem_size);
+		}
+	}
+	return TRUE;
+}
+
+// The blocked kernel shared by the float and double multiplies (result must already be zeroed).
+// i-k-j order within each block so the innermost loop walks rows of right and result.
+#define MATRIX_MULTIPLY_BLOCKED(type, left, right, result) do {										\
+	type *a = (left).vector->array;																	\
+	type *b = (right).vector->array;																\
+	type *c = (result).vector->array;																\
+																									\
+	for (size_t i0 = 0; i0 < (left).rows; i0 += MATRIX_BLOCK_SIZE) {								\
+		size_t i_end = MIN(i0 + MATRIX_BLOCK_SIZE, (left).rows);									\
+																									\
+		for (size_t k0 = 0; k0 < (left).columns; k0 += MATRIX_BLOCK_SIZE) {						\
+			size_t k_end = MIN(k0 + MATRIX_BLOCK_SIZE, (left).columns);								\
+																									\
+			for (size_t j0 = 0; j0 < (right).columns; j0 += MATRIX_BLOCK_SIZE) {					\
+				size_t j_end = MIN(j0 + MATRIX_BLOCK_SIZE, (right).columns);						\
+																									\
+				for (size_t i = i0; i < i_end; i++) {												\
+					type *c_row = c + (result).offset + i * (result).row_stride;					\
+																									\
+					for (size_t k = k0; k < k_end; k++) {											\
+						type a_ik = a[(left).offset + i * (left).row_stride + k * (left).column_stride];	\
+						type *b_row = b + (right).offset + k * (right).row_stride;					\
+																									\
+						for (size_t j = j0; j < j_end; j++) {										\
+							c_row[j * (result).column_stride] += a_ik * b_row[j * (right).column_stride];	\
+						}																			\
+					}																				\
+				}																					\
+			}																						\
+		}																							\
+	}																								\
+} while (0)
+
+/**
+ * Blocked matrix multiply of floats: result = left * right.
+ *
+ * @param left The left matrix view (n x k) of floats
+ * @param right The right matrix view (k x m) of floats
+ * @param result The matrix view to write into (n x m) of floats, which may not overlap left or right
+ */
+void matrix_multiply_float(MatrixView left, MatrixView right, MatrixView result) {
+	if (!matrix_multiply_prepare(left, right, result, sizeof(float), "matrix_multiply_float")) {
+		return;
+	}
+
+	MATRIX_MULTIPLY_BLOCKED(float, left, right, result);
+	vector_modified(result.vector, 0, result.vector->length);
+}
+
+/**
+ * Blocked matrix multiply of doubles: result = left * right.
+ *
+ * @param left The left matrix view (n x k) of doubles
+ * @param right The right matrix view (k x m) of doubles
+ * @param result The matrix view to write into (n x m) of doubles, which may not overlap left or right
+ */
+void matrix_multiply_double(MatrixView left, MatrixView right, MatrixView result) {
+	if (!matrix_multiply_prepare(left, right, result, sizeof(double), "matrix_multiply_double")) {
+		return;
+	}
+
+	MATRIX_MULTIPLY_BLOCKED(double, left, right, result);
+	vector_modified(result.vector, 0, result.vector->length);
+}
+
+#undef MATRIX_MULTIPLY_BLOCKED
+
+/**
+ * Complains if a matrix does not hold elements of the size a kernel reads them as.
+ *
+ * @param matrix The matrix view
+ * @param elem_size The size of the element type the kernel reads
+ * @param function_name The name of the kernel, for the error message
+ * @return Whether the elements are of that size
+ */
+static BOOL check_matrix_elem_size(MatrixView matrix, size_t elem_size, const char *function_name) {
+	if (matrix.vector->elem_size != elem_size) {
+		fprintf(stderr, "ERROR: %s attempted to read a matrix of the wrong element type!\n", function_name);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Sums every row of a matrix of doubles.
+ *
+ * @param matrix The matrix view of doubles
+ * @param sums Filled with one sum per row (must hold matrix.rows doubles)
+ */
+void matrix_row_sums_double(MatrixView matrix, double *sums) {
+	if (!check_matrix_elem_size(matrix, sizeof(double), "matrix_row_sums_double")) {
+		return;
+	}
+
+	double *data = matrix.vector->array;
+
+	for (size_t i = 0; i < matrix.rows; i++) {
+		double *row = data + matrix.offset + i * matrix.row_stride;
+		double sum = 0;
+
+		for (size_t j = 0; j < matrix.columns; j++) {
+			sum += row[j * matrix.column_stride];
+		}
+		sums[i] = sum;
+	}
+}
+
+/**
+ * Sums every column of a matrix of doubles.
+ *
+ * @param matrix The matrix view of doubles
+ * @param sums Filled with one sum per column (must hold matrix.columns doubles)
+ */
+void matrix_column_sums_double(MatrixView matrix, double *sums) {
+	if (!check_matrix_elem_size(matrix, sizeof(double), "matrix_column_sums_double")) {
+		return;
+	}
+
+	double *data = matrix.vector->array;
+
+	for (size_t j = 0; j < matrix.columns; j++) {
+		sums[j] = 0;
+	}
+
+	// Accumulate row by row rather than column by column so row-major storage is read in order
+	for (size_t i = 0; i < matrix.rows; i++) {
+		double *row = data + matrix.offset + i * matrix.row_stride;
+
+		for (size_t j = 0; j < matrix.columns; j++) {
+			sums[j] += row[j * matrix.column_stride];
+		}
+	}
+}
+
+/**
+ * Sums every row of a matrix of floats.
+ *
+ * @param matrix The matrix view of floats
+ * @param sums Filled with one sum per row (must hold matrix.rows floats)
+ */
+void matrix_row_sums_float(MatrixView matrix, float *sums) {
+	if (!check_matrix_elem_size(matrix, sizeof(float), "matrix_row_sums_float")) {
+		return;
+	}
+
+	float *data = matrix.vector->array;
+
+	for (size_t i = 0; i < matrix.rows; i++) {
+		float *row = data + matrix.offset + i * matrix.row_stride;
+		float sum = 0;
+
+		for (size_t j = 0; j < matrix.columns; j++) {
+			sum += row[j * matrix.column_stride];
+		}
+		sums[i] = sum;
+	}
+}
+
+/**
+ * Sums every column of a matrix of floats.
+ *
+ * @param matrix The matrix view of floats
+ * @param sums Filled with one sum per column (must hold matrix.columns floats)
+ */
+void matrix_column_sums_float(MatrixView matrix, float *sums) {
+	if (!check_matrix_elem_size(matrix, sizeof(float), "matrix_column_sums_float")) {
+		return;
+	}
+
+	float *data = matrix.vector->array;
+
+	for (size_t j = 0; j < matrix.columns; j++) {
+		sums[j] = 0;
+	}
+
+	// Accumulate row by row rather than column by column so row-major storage is read in order
+	for (size_t i = 0; i < matrix.rows; i++) {
+		float *row = data + matrix.offset + i * matrix.row_stride;
+
+		for (size_t j = 0; j < matrix.columns; j++) {
+			sums[j] += row[j * matrix.column_stride];
+		}
+	}
+}
+
+/**
+ * Collapses each run of equal neighbours in a sorted raw array down to its last element.
+ *
+ * @param array The sorted elements (each compared on its leading bytes)
+ * @param count The amount of elements
+ * @param stride The size (in bytes) of each element
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @return The amount of elements left
+ */
+static size_t unique_keep_last(void *array, size_t count, size_t stride, int (*compare)(void *elem1, void *elem2)) {
+	size_t kept = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (i + 1 < count && compare(array + i * stride, array + (i + 1) * stride) == 0) {
+			continue;
+		}
+		if (kept != i) {
+			memcpy(array + kept * stride, array + i * stride, stride);
+		}
+		kept++;
+	}
+
+	return kept;
+}
+
+/**
+ * Merges a sorted batch of unique keys (and optionally values) into sorted unique keys in place.
+ * Merging runs from the back into the free tail so every existing element moves at most once.
+ *
+ * @param keys The sorted unique keys to merge into
+ * @param values The values parallel to keys, or NULL for a set
+ * @param batch The sorted unique batch, each record holding a key followed by its value
+ * @param count The amount of records in the batch
+ * @param stride The size (in bytes) of each record of the batch
+ * @param compare The function pointer ordering the keys
+ * @return The amount of keys which were not already present
+ */
+static size_t merge_unique_batch(Vector *keys, Vector *values, void *batch, size_t count, size_t stride,
+		int (*compare)(void *elem1, void *elem2)) {
+	size_t key_size = keys->elem_size;
+	size_t length = keys->length;
+
+	if (!check_writable(keys, "merge_unique_batch") || (values != NULL && !check_writable(values, "merge_unique_batch"))) {
+		return 0;
+	}
+	if (!reserve_vector(keys, length + count) || (values != NULL && !reserve_vector(values, length + count))) {
+		return 0;
+	}
+
+	long i = (long) length - 1;
+	long j = (long) count - 1;
+	long write = (long) (length + count) - 1;
+	size_t inserted = 0;
+
+	while (j >= 0) {
+		void *batch_key = batch + j * stride;
+		int result = i >= 0 ? compare(get_elem(keys, i), batch_key) : -1;
+
+		// Raw copies: the attached indexes are brought up to date once the merge is done
+		if (result > 0) {
+			memcpy(get_elem(keys, write), get_elem(keys, i), key_size);
+			if (values != NULL) {
+				memcpy(get_elem(values, write), get_elem(values, i), values->elem_size);
+			}
+			i--;
+		} else {
+			memcpy(get_elem(keys, write), batch_key, key_size);
+			if (values != NULL) {
+				memcpy(get_elem(values, write), batch_key + key_size, values->elem_size);
+			}
+			if (result == 0) {
+				i--;
+			} else {
+				inserted++;
+			}
+			j--;
+		}
+		write--;
+	}
+
+	// Keys already present leave a gap below the merged region, so close it
+	if (write > i) {
+		void *from = get_elem(keys, write + 1);
+		memmove(get_elem(keys, i + 1), from, (length + count - (write + 1)) * key_size);
+		if (values != NULL) {
+			from = get_elem(values, write + 1);
+			memmove(get_elem(values, i + 1), from, (length + count - (write + 1)) * values->elem_size);
+		}
+	}
+
+	// Everything from just past the untouched prefix (up to index i) has moved or changed
+	keys->length = length + inserted;
+	vector_modified(keys, i + 1, keys->length);
+	if (values != NULL) {
+		values->length = length + inserted;
+		vector_modified(values, i + 1, values->length);
+	}
+	return inserted;
+}
+
+/**
+ * Create a new, empty flat set.
+ *
+ * @param elem_size The size of each element in the set
+ * @param compare The function pointer ordering the elements (as in sort_vector)
+ * @return The generated flat set
+ */
+FlatSet* create_flat_set(size_t elem_size, int (*compare)(void *elem1, void *elem2)) {
+	FlatSet *set = malloc(sizeof(FlatSet));
+	set->elements = create_vector(elem_size);
+	set->compare = compare;
+
+	return set;
+}
+
+/**
+ * Searches a flat set for an element (O(log n)).
+ *
+ * @param set The flat set
+ * @param element The element to search for
+ * @return The index of the found element, or -1 if it does not exist
+ */
+int flat_set_find(FlatSet *set, void *element) {
+	int index = lower_bound(set->elements, element, set->compare);
+
+	if (index < set->elements->length && set->compare(get_elem(set->elements, index), element) == 0) {
+		return index;
+	}
+	return -1;
+}
+
+/**
+ * Inserts an element into a flat set, keeping it sorted with a single memmove.
+ *
+ * @param set The flat set
+ * @param element The element to insert
+ * @return Whether the element was inserted (FALSE if it was already present)
+ */
+BOOL flat_set_insert(FlatSet *set, void *element) {
+	int index = lower_bound(set->elements, element, set->compare);
+
+	if (index < set->elements->length && set->compare(get_elem(set->elements, index), element) == 0) {
+		return FALSE;
+	}
+
+	insert_elem(set->elements, index, element);
+	return TRUE;
+}
+
+/**
+ * Inserts many elements into a flat set at once.
+ * The batch is sorted and then merged into the set from the back, growing the set only once.
+ *
+ * @param set The flat set
+ * @param batch The vector of elements to insert (left untouched)
+ * @return The amount of elements which were not already present
+ */
+size_t flat_set_insert_bulk(FlatSet *set, Vector *batch) {
+	size_t elem_size = set->elements->elem_size;
+	if (batch->elem_size != elem_size) {
+		fprintf(stderr, "ERROR: Attempted to bulk insert elements of the wrong size into a flat set!\n");
+		return 0;
+	}
+	void *sorted = malloc(batch->length * elem_size + 1);
+
+	memcpy(sorted, batch->array, batch->length * elem_size);
+	merge_sort_elems(sorted, batch->length, elem_size, set->compare);
+	size_t count = unique_keep_last(sorted, batch->length, elem_size, set->compare);
+
+	size_t inserted = merge_unique_batch(set->elements, NULL, sorted, count, elem_size, set->compare);
+
+	free(sorted);
+	return inserted;
+}
+
+/**
+ * Removes an element from a flat set, keeping it sorted.
+ *
+ * @param set The flat set
+ * @param element The element to remove
+ * @return Whether the element was present
+ */
+BOOL flat_set_erase(FlatSet *set, void *element) {
+	int index = flat_set_find(set, element);
+
+	if (index == -1) {
+		return FALSE;
+	}
+
+	remove_elem(set->elements, index);
+	return TRUE;
+}
+
+/**
+ * Finds every element of a flat set within [low, high).
+ *
+ * @param set The flat set
+ * @param low The inclusive lower bound
+ * @param high The exclusive upper bound
+ * @param first Set to the index of the first element in range
+ * @return The amount of elements in range (they lie contiguously from first)
+ */
+size_t flat_set_range(FlatSet *set, void *low, void *high, int *first) {
+	int start = lower_bound(set->elements, low, set->compare);
+	int end = lower_bound(set->elements, high, set->compare);
+
+	*first = start;
+	return end > start ? end - start : 0;
+}
+
+/**
+ * Memory management: Deallocate a flat set.
+ *
+ * @param set The flat set to deallocate
+ */
+void free_flat_set(FlatSet *set) {
+	free_vector(set->elements);
+	free(set);
+}
+
+/**
+ * Create a new, empty flat map.
+ *
+ * @param key_size The size of each key in the map
+ * @param value_size The size of each value in the map
+ * @param compare The function pointer ordering the keys (as in sort_vector)
+ * @return The generated flat map
+ */
+FlatMap* create_flat_map(size_t key_size, size_t value_size, int (*compare)(void *elem1, void *elem2)) {
+	FlatMap *map = malloc(sizeof(FlatMap));
+	map->keys = create_vector(key_size);
+	map->values = create_vector(value_size);
+	map->compare = compare;
+
+	return map;
+}
+
+/**
+ * Looks up the value of a key in a flat map (O(log n)).
+ *
+ * @param map The flat map
+ * @param key The key to search for
+ * @return The value as void*, or NULL if the key does not exist
+ */
+void* flat_map_find(FlatMap *map, void *key) {
+	int index = lower_bound(map->keys, key, map->compare);
+
+	if (index < map->keys->length && map->compare(get_elem(map->keys, index), key) == 0) {
+		return get_elem(map->values, index);
+	}
+	return NULL;
+}
+
+/**
+ * Inserts a key and value into a flat map, overwriting the value if the key already exists.
+ *
+ * @param map The flat map
+ * @param key The key to insert
+ * @param value The value to associate with the key
+ * @return Whether the key was new
+ */
+BOOL flat_map_insert(FlatMap *map, void *key, void *value) {
+	int index = lower_bound(map->keys, key, map->compare);
+
+	if (index < map->keys->length && map->compare(get_elem(map->keys, index), key) == 0) {
+		set_elem(map->values, index, value);
+		return FALSE;
+	}
+
+	insert_elem(map->keys, index, key);
+	insert_elem(map->values, index, value);
+	return TRUE;
+}
+
+/**
+ * Inserts many keys and values into a flat map at once.
+ * The batch is sorted and then merged into the map from the back, growing the map only once.
+ * Where a key appears more than once, the value pushed last wins.
+ *
+ * @param map The flat map
+ * @param keys The vector of keys to insert (left untouched)
+ * @param values The vector of values to insert, parallel to keys (left untouched)
+ * @return The amount of keys which were not already present
+ */
+size_t flat_map_insert_bulk(FlatMap *map, Vector *keys, Vector *values) {
+	if (keys->length != values->length) {
+		fprintf(stderr, "ERROR: Attempted to bulk insert a different amount of keys and values!\n");
+		return 0;
+	}
+	if (keys->elem_size != map->keys->elem_size || values->elem_size != map->values->elem_size) {
+		fprintf(stderr, "ERROR: Attempted to bulk insert keys or values of the wrong size into a flat map!\n");
+		return 0;
+	}
+
+	// Pack each key and value into one record so sorting on the leading key moves both.
+	// Records are padded to MAX_ALIGN so every key compare reads is as aligned as malloc memory.
+	size_t key_size = map->keys->elem_size;
+	size_t stride = (key_size + map->values->elem_size + MAX_ALIGN - 1) / MAX_ALIGN * MAX_ALIGN;
+	void *records = malloc(keys->length * stride + 1);
+
+	for (int i = 0; i < keys->length; i++) {
+		memcpy(records + i * stride, get_elem(keys, i), key_size);
+		memcpy(records + i * stride + key_size, get_elem(values, i), map->values->elem_size);
+	}
+	merge_sort_elems(records, keys->length, stride, map->compare);
+	size_t count = unique_keep_last(records, keys->length, stride, map->compare);
+
+	size_t inserted = merge_unique_batch(map->keys, map->values, records, count, stride, map->compare);
+
+	free(records);
+	return inserted;
+}
+
+/**
+ * Removes a key and its value from a flat map.
+ *
+ * @param map The flat map
+ * @param key The key to remove
+ * @return Whether the key was present
+ */
+BOOL flat_map_erase(FlatMap *map, void *key) {
+	int index = lower_bound(map->keys, key, map->compare);
+
+	if (index >= map->keys->length || map->compare(get_elem(map->keys, index), key) != 0) {
+		return FALSE;
+	}
+
+	remove_elem(map->keys, index);
+	remove_elem(map->values, index);
+	return TRUE;
+}
+
+/**
+ * Finds every key of a flat map within [low, high).
+ *
+ * @param map The flat map
+ * @param low The inclusive lower bound
+ * @param high The exclusive upper bound
+ * @param first Set to the index (into keys and values) of the first key in range
+ * @return The amount of keys in range (they lie contiguously from first)
+ */
+size_t flat_map_range(FlatMap *map, void *low, void *high, int *first) {
+	int start = lower_bound(map->keys, low, map->compare);
+	int end = lower_bound(map->keys, high, map->compare);
+
+	*first = start;
+	return end > start ? end - start : 0;
+}
+
+/**
+ * Memory management: Deallocate a flat map.
+ *
+ * @param map The flat map to deallocate
+ */
+void free_flat_map(FlatMap *map) {
+	free_vector(map->keys);
+	free_vector(map->values);
+	free(map);
+}
+
+/**
+ * Whether the next element of one merge source should be output before that of another.
+ * Exhausted sources lose to everything, and ties go to the earlier source.
+ *
+ * @param vectors The sources
+ * @param positions The index of the next element of each source
+ * @param a The first source
+ * @param b The second source
+ * @param compare The function pointer to compare two similar elements
+ * @return Whether source a wins
+ */
+static BOOL kway_beats(Vector **vectors, size_t *positions, int a, int b, int (*compare)(void *elem1, void *elem2)) {
+	BOOL a_done = positions[a] >= vectors[a]->length;
+	BOOL b_done = positions[b] >= vectors[b]->length;
+
+	if (a_done || b_done) {
+		return !a_done || (b_done && a < b);
+	}
+
+	int result = compare(get_elem(vectors[a], positions[a]), get_elem(vectors[b], positions[b]));
+	return result < 0 || (result == 0 && a < b);
+}
+
+/**
+ * Appends an element to the vector given as context (the emit callback behind kway_merge).
+ *
+ * @param element The element to append
+ * @param context The vector to append to
+ */
+static void kway_append(void *element, void *context) {
+	Vector *out = context;
+
+	if (!reserve_vector(out, out->length + 1)) {
+		return;
+	}
+	memcpy(out->array + out->length * out->elem_size, element, out->elem_size);
+	out->length++;
+	vector_modified(out, out->length - 1, out->length);
+}
+
+/**
+ * Merges many vectors, each sorted by compare, into one sorted output appended to out.
+ * Uses a loser tree, so each output element costs O(log count) comparisons.
+ *
+ * @param vectors The sorted vectors to merge (left untouched)
+ * @param count The amount of vectors
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @param dedup Whether to drop elements which compare equal to the one output before them
+ * @param out The vector to append the merged elements to
+ * @return The amount of elements appended
+ */
+size_t kway_merge(Vector **vectors, int count, int (*compare)(void *elem1, void *elem2), BOOL dedup, Vector *out) {
+	if (!check_writable(out, "kway_merge")) {
+		return 0;
+	}
+
+	size_t total = out->length;
+	for (int i = 0; i < count; i++) {
+		total += vectors[i]->length;
+	}
+	if (!reserve_vector(out, total)) {
+		return 0;
+	}
+
+	return kway_merge_stream(vectors, count, compare, dedup, kway_append, out);
+}
+
+/**
+ * Merges many vectors, each sorted by compare, handing every merged element to a callback
+ * as it is produced instead of storing it (eg. so it can be written straight out).
+ * Ties between vectors are output in the order the vectors are given.
+ *
+ * @param vectors The sorted vectors to merge (left untouched)
+ * @param count The amount of vectors
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ * @param dedup Whether to drop elements which compare equal to the one output before them
+ * @param emit The function pointer called with each merged element, in order
+ * @param context Passed through untouched to every call of emit
+ * @return The amount of elements emitted
+ */
+size_t kway_merge_stream(Vector **vectors, int count, int (*compare)(void *elem1, void *elem2), BOOL dedup,
+		void (*emit)(void *element, void *context), void *context) {
+	if (count <= 0) {
+		return 0;
+	}
+
+	for (int i = 1; i < count; i++) {
+		if (vectors[i]->elem_size != vectors[0]->elem_size) {
+			fprintf(stderr, "ERROR: Attempted to merge vectors with inequal element sizes!\n");
+			return 0;
+		}
+	}
+
+	size_t elem_size = vectors[0]->elem_size;
+	size_t *positions = calloc(count, sizeof(size_t));
+
+	// tree[1, count) holds the loser of each match, tree[0] the overall winner.
+	// Source i sits at leaf count + i, and winners[] is only needed while building.
+	int *tree = malloc(count * sizeof(int));
+	int *winners = malloc(2 * count * sizeof(int));
+	for (int i = 0; i < count; i++) {
+		winners[count + i] = i;
+	}
+	for (int node = count - 1; node >= 1; node--) {
+		int left = winners[2 * node];
+		int right = winners[2 * node + 1];
+
+		if (kway_beats(vectors, positions, left, right, compare)) {
+			winners[node] = left;
+			tree[node] = right;
+		} else {
+			winners[node] = right;
+			tree[node] = left;
+		}
+	}
+	tree[0] = count > 1 ? winners[1] : 0;
+	free(winners);
+
+	void *last = malloc(elem_size);
+	BOOL has_last = FALSE;
+	size_t emitted = 0;
+
+	while (positions[tree[0]] < vectors[tree[0]]->length) {
+		int winner = tree[0];
+		void *element = get_elem(vectors[winner], positions[winner]);
+
+		if (!dedup || !has_last || compare(last, element) != 0) {
+			emit(element, context);
+			emitted++;
+			if (dedup) {
+				memcpy(last, element, elem_size);
+				has_last = TRUE;
+			}
+		}
+		positions[winner]++;
+
+		// Replay the winner's path to the root against the stored losers
+		for (int node = (winner + count) / 2; node >= 1; node /= 2) {
+			if (kway_beats(vectors, positions, tree[node], winner, compare)) {
+				int temp = tree[node];
+				tree[node] = winner;
+				winner = temp;
+			}
+		}
+		tree[0] = winner;
+	}
+
+	free(last);
+	free(tree);
+	free(positions);
+	return emitted;
+}
+
+/**
+ * Whether heap operations may be used on a vector with a given arity.
+ *
+ * @param vector The vector holding the heap
+ * @param arity The amount of children per node
+ * @return Whether the vector can be used as a heap
+ */
+static BOOL heap_usable(Vector *vector, int arity) {
+	if (!check_writable(vector, "heap operation")) {
+		return FALSE;
+	}
+	if (arity < 2) {
+		fprintf(stderr, "ERROR: Heap arity must be at least 2!\n");
+		return FALSE;
+	}
+	if (vector->sorted_by != NULL) {
+		fprintf(stderr, "ERROR: Attempted heap operations on a vector in sorted mode!\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Places an element at a position of a d-ary heap, moving it down below any children which
+ * compare ahead of it. The children are moved up into the hole rather than swapped.
+ *
+ * @param vector The vector holding the heap
+ * @param arity The amount of children per node
+ * @param hole The position to start at (its current contents are overwritten)
+ * @param element The element to place (may live anywhere, including inside the vector)
+ * @param compare The function pointer the heap is ordered by
+ */
+static void heap_sift_down(Vector *vector, int arity, size_t hole, void *element, int (*compare)(void *elem1, void *elem2)) {
+	// Small elements (the common case for timers and ids) avoid a malloc per operation;
+	// the buffer is aligned like malloc memory so compare can read it as the element type
+	_Alignas(max_align_t) char stack_temp[64];
+	void *temp = vector->elem_size <= sizeof(stack_temp) ? stack_temp : malloc(vector->elem_size);
+	memcpy(temp, element, vector->elem_size);
+
+	while (TRUE) {
+		size_t first_child = hole * arity + 1;
+		if (first_child >= vector->length) {
+			break;
+		}
+
+		size_t last_child = MIN(first_child + arity, vector->length);
+		size_t best = first_child;
+		for (size_t child = first_child + 1; child < last_child; child++) {
+			if (compare(get_elem(vector, child), get_elem(vector, best)) < 0) {
+				best = child;
+			}
+		}
+
+		if (compare(get_elem(vector, best), temp) >= 0) {
+			break;
+		}
+		set_elem(vector, hole, get_elem(vector, best));
+		hole = best;
+	}
+
+	set_elem(vector, hole, temp);
+	if (temp != stack_temp) {
+		free(temp);
+	}
+}
+
+/**
+ * Rearranges a vector into a binary min-heap (the element compare orders first sits at index 0) in O(n).
+ *
+ * @param vector The vector
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+void heapify(Vector *vector, int (*compare)(void *elem1, void *elem2)) {
+	heapify_dary(vector, 2, compare);
+}
+
+/**
+ * Pushes an element onto a binary heap (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param element The element to push
+ * @param compare The function pointer the heap is ordered by
+ */
+void heap_push(Vector *vector, void *element, int (*compare)(void *elem1, void *elem2)) {
+	heap_push_dary(vector, 2, element, compare);
+}
+
+/**
+ * Pops the first element off a binary heap (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param out Filled with the popped element (may be NULL)
+ * @param compare The function pointer the heap is ordered by
+ * @return Whether an element was popped (FALSE if the heap was empty)
+ */
+BOOL heap_pop(Vector *vector, void *out, int (*compare)(void *elem1, void *elem2)) {
+	return heap_pop_dary(vector, 2, out, compare);
+}
+
+/**
+ * Pops the first element off a binary heap and pushes a new one in a single pass (O(log n)).
+ * Cheaper than a heap_pop followed by a heap_push.
+ *
+ * @param vector The vector holding the heap
+ * @param element The element to push
+ * @param out Filled with the popped element (may be NULL)
+ * @param compare The function pointer the heap is ordered by
+ * @return Whether an element was popped (FALSE if the heap was empty, in which case element is just pushed)
+ */
+BOOL heap_replace(Vector *vector, void *element, void *out, int (*compare)(void *elem1, void *elem2)) {
+	return heap_replace_dary(vector, 2, element, out, compare);
+}
+
+/**
+ * Rearranges a vector into a d-ary min-heap in O(n).
+ * Wider heaps (eg. arity 4) are shallower and keep each node's children on one cache line.
+ *
+ * @param vector The vector
+ * @param arity The amount of children per node (at least 2)
+ * @param compare The function pointer to compare two similar elements (as in sort_vector)
+ */
+void heapify_dary(Vector *vector, int arity, int (*compare)(void *elem1, void *elem2)) {
+	if (!heap_usable(vector, arity) || vector->length < 2) {
+		return;
+	}
+
+	for (size_t i = (vector->length - 2) / arity + 1; i > 0; i--) {
+		heap_sift_down(vector, arity, i - 1, get_elem(vector, i - 1), compare);
+	}
+}
+
+/**
+ * Pushes an element onto a d-ary heap (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param arity The amount of children per node (at least 2)
+ * @param element The element to push
+ * @param compare The function pointer the heap is ordered by
+ */
+void heap_push_dary(Vector *vector, int arity, void *element, int (*compare)(void *elem1, void *elem2)) {
+	if (!heap_usable(vector, arity)) {
+		return;
+	}
+
+	if (!reserve_vector(vector, vector->length + 1)) {
+		return;
+	}
+	vector->length++;
+
+	// Walk a hole up from the new leaf, moving parents down into it, then drop the element in
+	size_t hole = vector->length - 1;
+	while (hole > 0) {
+		size_t parent = (hole - 1) / arity;
+		void *parent_elem = get_elem(vector, parent);
+
+		if (compare(element, parent_elem) >= 0) {
+			break;
+		}
+		set_elem(vector, hole, parent_elem);
+		hole = parent;
+	}
+	set_elem(vector, hole, element);
+}
+
+/**
+ * Pops the first element off a d-ary heap (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param arity The amount of children per node (at least 2)
+ * @param out Filled with the popped element (may be NULL)
+ * @param compare The function pointer the heap is ordered by
+ * @return Whether an element was popped (FALSE if the heap was empty)
+ */
+BOOL heap_pop_dary(Vector *vector, int arity, void *out, int (*compare)(void *elem1, void *elem2)) {
+	if (!heap_usable(vector, arity) || vector->length == 0) {
+		return FALSE;
+	}
+
+	if (out != NULL) {
+		memcpy(out, get_elem(vector, 0), vector->elem_size);
+	}
+
+	vector->length--;
+	vector_modified(vector, vector->length, vector->length + 1);
+	if (vector->length > 0) {
+		heap_sift_down(vector, arity, 0, get_elem(vector, vector->length), compare);
+	}
+	return TRUE;
+}
+
+/**
+ * Pops the first element off a d-ary heap and pushes a new one in a single pass (O(log n)).
+ *
+ * @param vector The vector holding the heap
+ * @param arity The amount of children per node (at least 2)
+ * @param element The element to push
+ * @param out Filled with the popped element (may be NULL)
+ * @param compare The function pointer the heap is ordered by
+ * @return Whether an element was popped (FALSE if the heap was empty, in which case element is just pushed)
+ */
+BOOL heap_replace_dary(Vector *vector, int arity, void *element, void *out, int (*compare)(void *elem1, void *elem2)) {
+	if (!heap_usable(vector, arity)) {
+		return FALSE;
+	}
+
+	if (vector->length == 0) {
+		heap_push_dary(vector, arity, element, compare);
+		return FALSE;
+	}
+
+	if (out != NULL) {
+		memcpy(out, get_elem(vector, 0), vector->elem_size);
+	}
+	heap_sift_down(vector, arity, 0, element, compare);
+	return TRUE;
+}
+
+/**
+ * Allocates an empty B+tree node.
+ *
+ * @param elem_size The size of each element in the tree
+ * @param is_leaf Whether the node is a leaf
+ * @return The generated node
+ */
+static BTreeNode* btree_create_node(size_t elem_size, BOOL is_leaf) {
+	BTreeNode *node = malloc(sizeof(BTreeNode));
+	node->is_leaf = is_leaf;
+	node->elements = create_vector_with_capacity(elem_size, is_leaf ? BTREE_LEAF_SIZE : BTREE_FANOUT);
+	node->children = is_leaf ? NULL : malloc((BTREE_FANOUT + 1) * sizeof(BTreeNode*));
+	node->child_count = 0;
+	node->parent = NULL;
+	node->prev = NULL;
+	node->next = NULL;
+
+	return node;
+}
+
+/**
+ * Memory management: Deallocate a B+tree node and everything below it.
+ *
+ * @param node The node to deallocate
+ */
+static void free_btree_node(BTreeNode *node) {
+	for (size_t i = 0; i < node->child_count; i++) {
+		free_btree_node(node->children[i]);
+	}
+	free(node->children);
+	free_vector(node->elements);
+	free(node);
+}
+
+/**
+ * Walks from the root of a B+tree to the leaf where an element belongs.
+ *
+ * @param tree The B+tree
+ * @param element The element to look for
+ * @param after_equal Whether to head for the last place the element could go rather than the first
+ * @return The leaf
+ */
+static BTreeNode* btree_find_leaf(BTree *tree, void *element, BOOL after_equal) {
+	BTreeNode *node = tree->root;
+
+	while (!node->is_leaf) {
+		int child = after_equal
+				? upper_bound(node->elements, element, tree->compare)
+				: lower_bound(node->elements, element, tree->compare);
+		node = node->children[child];
+	}
+
+	return node;
+}
+
+/**
+ * Finds the first element of a B+tree which is not less than a given element.
+ *
+ * @param tree The B+tree
+ * @param element The element to look for
+ * @param position Set to the index of the found element within its leaf
+ * @return The leaf holding the found element, or NULL if every element is less
+ */
+static BTreeNode* btree_lower_bound(BTree *tree, void *element, int *position) {
+	BTreeNode *leaf = btree_find_leaf(tree, element, FALSE);
+	*position = lower_bound(leaf->elements, element, tree->compare);
+
+	// Every element of this leaf may be less, in which case the answer starts the next leaf
+	if (*position == leaf->elements->length) {
+		leaf = leaf->next;
+		*position = 0;
+	}
+
+	return leaf;
+}
+
+/**
+ * Hooks a new node into the parent of an existing node, directly to its right,
+ * splitting the parent (and so on upwards) if it overflows.
+ *
+ * @param tree The B+tree
+ * @param left The existing node
+ * @param right The new node
+ * @param separator The key separating left from right
+ */
+static void btree_insert_child(BTree *tree, BTreeNode *left, BTreeNode *right, void *separator) {
+	BTreeNode *parent = left->parent;
+
+	if (parent == NULL) {
+		parent = btree_create_node(tree->elem_size, FALSE);
+		parent->children[0] = left;
+		parent->child_count = 1;
+		left->parent = parent;
+		tree->root = parent;
+	}
+
+	int slot = 0;
+	while (parent->children[slot] != left) {
+		slot++;
+	}
+
+	insert_elem(parent->elements, slot, separator);
+	memmove(&parent->children[slot + 2], &parent->children[slot + 1], (parent->child_count - slot - 1) * sizeof(BTreeNode*));
+	parent->children[slot + 1] = right;
+	parent->child_count++;
+	right->parent = parent;
+
+	if (parent->child_count <= BTREE_FANOUT) {
+		return;
+	}
+
+	// Split the children in half, promoting the key between the halves
+	size_t half = parent->child_count / 2;
+	BTreeNode *sibling = btree_create_node(tree->elem_size, FALSE);
+
+	sibling->child_count = parent->child_count - half;
+	memcpy(sibling->children, &parent->children[half], sibling->child_count * sizeof(BTreeNode*));
+	for (size_t i = 0; i < sibling->child_count; i++) {
+		sibling->children[i]->parent = sibling;
+	}
+	memcpy(sibling->elements->array, get_elem(parent->elements, half), (sibling->child_count - 1) * tree->elem_size);
+	sibling->elements->length = sibling->child_count - 1;
+
+	// Aligned like the malloc fallback, so it is a valid home for any element type
+	_Alignas(max_align_t) char stack_promoted[64];
+	void *promoted = tree->elem_size <= sizeof(stack_promoted) ? stack_promoted : malloc(tree->elem_size);
+	memcpy(promoted, get_elem(parent->elements, half - 1), tree->elem_size);
+	parent->elements->length = half - 1;
+	parent->child_count = half;
+
+	btree_insert_child(tree, parent, sibling, promoted);
+	if (promoted != stack_promoted) {
+		free(promoted);
+	}
+}
+
+/**
+ * Splits a full leaf in half, moving the upper half into a new leaf to its right.
+ *
+ * @param tree The B+tree
+ * @param leaf The full leaf
+ */
+static void btree_split_leaf(BTree *tree, BTreeNode *leaf) {
+	size_t half = leaf->elements->length / 2;
+	BTreeNode *right = btree_create_node(tree->elem_size, TRUE);
+
+	right->elements->length = leaf->elements->length - half;
+	memcpy(right->elements->array, get_elem(leaf->elements, half), right->elements->length * tree->elem_size);
+	leaf->elements->length = half;
+
+	right->prev = leaf;
+	right->next = leaf->next;
+	if (leaf->next != NULL) {
+		leaf->next->prev = right;
+	}
+	leaf->next = right;
+
+	btree_insert_child(tree, leaf, right, get_elem(right->elements, 0));
+}
+
+/**
+ * Unhooks an empty node from its parent and frees it, removing the parent too if it empties,
+ * and collapsing the root while it has a single child.
+ *
+ * @param tree The B+tree
+ * @param node The empty node to remove (not the root)
+ */
+static void btree_remove_child(BTree *tree, BTreeNode *node) {
+	BTreeNode *parent = node->parent;
+
+	int slot = 0;
+	while (parent->children[slot] != node) {
+		slot++;
+	}
+
+	memmove(&parent->children[slot], &parent->children[slot + 1], (parent->child_count - slot - 1) * sizeof(BTreeNode*));
+	parent->child_count--;
+	if (parent->elements->length > 0) {
+		remove_elem(parent->elements, slot > 0 ? slot - 1 : 0);
+	}
+
+	node->child_count = 0;
+	free_btree_node(node);
+
+	if (parent->child_count == 0 && parent != tree->root) {
+		btree_remove_child(tree, parent);
+		return;
+	}
+
+	while (!tree->root->is_leaf && tree->root->child_count == 1) {
+		BTreeNode *root = tree->root;
+		tree->root = root->children[0];
+		tree->root->parent = NULL;
+		root->child_count = 0;
+		free_btree_node(root);
+	}
+
+	if (!tree->root->is_leaf && tree->root->child_count == 0) {
+		free_btree_node(tree->root);
+		tree->root = btree_create_node(tree->elem_size, TRUE);
+		tree->first_leaf = tree->root;
+	}
+}
+
+/**
+ * Create a new, empty B+tree.
+ *
+ * @param elem_size The size of each element in the tree
+ * @param compare The function pointer ordering the elements (as in sort_vector)
+ * @return The generated B+tree
+ */
+BTree* create_btree(size_t elem_size, int (*compare)(void *elem1, void *elem2)) {
+	BTree *tree = malloc(sizeof(BTree));
+	tree->root = btree_create_node(elem_size, TRUE);
+	tree->first_leaf = tree->root;
+	tree->elem_size = elem_size;
+	tree->length = 0;
+	tree->compare = compare;
+
+	return tree;
+}
+
+/**
+ * Creates a B+tree holding every element of a vector already sorted by compare.
+ * The leaves are filled to three quarters straight from the vector and the tree built bottom up (O(n)).
+ *
+ * @param sorted The vector to load, sorted by compare (left untouched)
+ * @param compare The function pointer ordering the elements (as in sort_vector)
+ * @return The generated B+tree
+ */
+BTree* create_btree_from_sorted(Vector *sorted, int (*compare)(void *elem1, void *elem2)) {
+	BTree *tree = create_btree(sorted->elem_size, compare);
+	if (sorted->length == 0) {
+		return tree;
+	}
+
+	size_t elem_size = sorted->elem_size;
+	size_t fill = BTREE_LEAF_SIZE * 3 / 4;
+	Vector *level = create_vector(sizeof(BTreeNode*));
+	Vector *minimums = create_vector(sizeof(void*));
+
+	free_btree_node(tree->root);
+	BTreeNode *prev = NULL;
+	for (size_t start = 0; start < sorted->length; start += fill) {
+		size_t count = MIN(fill, sorted->length - start);
+		BTreeNode *leaf = btree_create_node(elem_size, TRUE);
+
+		memcpy(leaf->elements->array, get_elem(sorted, start), count * elem_size);
+		leaf->elements->length = count;
+		leaf->prev = prev;
+		if (prev != NULL) {
+			prev->next = leaf;
+		}
+		prev = leaf;
+
+		void *minimum = get_elem(leaf->elements, 0);
+		push_back(level, &leaf);
+		push_back(minimums, &minimum);
+	}
+	tree->first_leaf = *(BTreeNode**) get_elem(level, 0);
+
+	// Group each level into parents of up to BTREE_FANOUT children until one node is left
+	while (level->length > 1) {
+		Vector *parents = create_vector(sizeof(BTreeNode*));
+		Vector *parent_minimums = create_vector(sizeof(void*));
+
+		for (size_t start = 0; start < level->length; start += BTREE_FANOUT) {
+			size_t count = MIN(BTREE_FANOUT, level->length - start);
+			BTreeNode *parent = btree_create_node(elem_size, FALSE);
+
+			for (size_t i = 0; i < count; i++) {
+				BTreeNode *child = *(BTreeNode**) get_elem(level, start + i);
+				child->parent = parent;
+				parent->children[i] = child;
+				if (i > 0) {
+					push_back(parent->elements, *(void**) get_elem(minimums, start + i));
+				}
+			}
+			parent->child_count = count;
+
+			push_back(parents, &parent);
+			push_back(parent_minimums, get_elem(minimums, start));
+		}
+
+		free_vector(level);
+		free_vector(minimums);
+		level = parents;
+		minimums = parent_minimums;
+	}
+
+	tree->root = *(BTreeNode**) get_elem(level, 0);
+	tree->length = sorted->length;
+	free_vector(level);
+	free_vector(minimums);
+	return tree;
+}
+
+/**
+ * Inserts an element into a B+tree (O(log n)), after any elements equal to it.
+ *
+ * @param tree The B+tree
+ * @param element The element to insert
+ */
+void btree_insert(BTree *tree, void *element) {
+	BTreeNode *leaf = btree_find_leaf(tree, element, TRUE);
+	int position = upper_bound(leaf->elements, element, tree->compare);
+
+	insert_elem(leaf->elements, position, element);
+	tree->length++;
+
+	if (leaf->elements->length >= BTREE_LEAF_SIZE) {
+		btree_split_leaf(tree, leaf);
+	}
+}
+
+/**
+ * Searches a B+tree for an element (O(log n)).
+ *
+ * @param tree The B+tree
+ * @param element The element to search for
+ * @return The first stored element comparing equal, or NULL if there is none
+ */
+void* btree_find(BTree *tree, void *element) {
+	int position;
+	BTreeNode *leaf = btree_lower_bound(tree, element, &position);
+
+	if (leaf == NULL || tree->compare(get_elem(leaf->elements, position), element) != 0) {
+		return NULL;
+	}
+	return get_elem(leaf->elements, position);
+}
+
+/**
+ * Removes one element comparing equal to a given element from a B+tree (O(log n)).
+ * Leaves are not merged as they shrink, only released once empty.
+ *
+ * @param tree The B+tree
+ * @param element The element to remove
+ * @return Whether an element was removed
+ */
+BOOL btree_erase(BTree *tree, void *element) {
+	int position;
+	BTreeNode *leaf = btree_lower_bound(tree, element, &position);
+
+	if (leaf == NULL || tree->compare(get_elem(leaf->elements, position), element) != 0) {
+		return FALSE;
+	}
+
+	remove_elem(leaf->elements, position);
+	tree->length--;
+
+	if (leaf->elements->length == 0 && leaf != tree->root) {
+		if (leaf->prev != NULL) {
+			leaf->prev->next = leaf->next;
+		} else {
+			tree->first_leaf = leaf->next;
+		}
+		if (leaf->next != NULL) {
+			leaf->next->prev = leaf->prev;
+		}
+		btree_remove_child(tree, leaf);
+	}
+	return TRUE;
+}
+
+/**
+ * Iterates over every element of a B+tree in order, one contiguous leaf at a time.
+ *
+ * @param tree The B+tree
+ * @param visit The function pointer called with each element
+ * @param context Passed through untouched to every call of visit
+ */
+void btree_for_each(BTree *tree, void (*visit)(void *element, void *context), void *context) {
+	for (BTreeNode *leaf = tree->first_leaf; leaf != NULL; leaf = leaf->next) {
+		for (int i = 0; i < leaf->elements->length; i++) {
+			visit(get_elem(leaf->elements, i), context);
+		}
+	}
+}
+
+/**
+ * Memory management: Deallocate a B+tree.
+ *
+ * @param tree The B+tree to deallocate
+ */
+void free_btree(BTree *tree) {
+	free_btree_node(tree->root);
+	free(tree);
+}
+
+/**
+ * Create a new, empty slot map.
+ *
+ * @param elem_size The size of each element in the slot map
+ * @return The generated slot map
+ */
+SlotMap* create_slot_map(size_t elem_size) {
+	SlotMap *map = malloc(sizeof(SlotMap));
+	map->elements = create_vector(elem_size);
+	map->dense_slots = create_vector(sizeof(unsigned int));
+	map->slots = create_vector(sizeof(SlotHandle));
+	map->free_head = SLOT_MAP_NONE;
+
+	return map;
+}
+
+/**
+ * Inserts an element into a slot map (O(1)), reusing a free slot if there is one.
+ *
+ * @param map The slot map
+ * @param element The element to insert
+ * @return The handle to the element, valid until it is removed
+ */
+SlotHandle slot_map_insert(SlotMap *map, void *element) {
+	unsigned int dense = map->elements->length;
+	SlotHandle handle;
+
+	if (map->free_head != SLOT_MAP_NONE) {
+		SlotHandle *slot = get_elem(map->slots, map->free_head);
+		handle.index = map->free_head;
+		handle.generation = slot->generation;
+		map->free_head = slot->index;
+		slot->index = dense;
+	} else {
+		SlotHandle slot = { dense, 0 };
+		handle.index = map->slots->length;
+		handle.generation = 0;
+		push_back(map->slots, &slot);
+	}
+
+	push_back(map->elements, element);
+	push_back(map->dense_slots, &handle.index);
+	return handle;
+}
+
+/**
+ * Gets the element a handle refers to (O(1)).
+ *
+ * @param map The slot map
+ * @param handle The handle
+ * @return The value as void*, or NULL if the handle is stale
+ */
+void* slot_map_get(SlotMap *map, SlotHandle handle) {
+	if (handle.index >= map->slots->length) {
+		return NULL;
+	}
+
+	SlotHandle *slot = get_elem(map->slots, handle.index);
+	if (slot->generation != handle.generation) {
+		return NULL;
+	}
+	return get_elem(map->elements, slot->index);
+}
+
+/**
+ * Removes the element a handle refers to (O(1)).
+ * The last dense element is moved into its place, so other handles stay valid.
+ *
+ * @param map The slot map
+ * @param handle The handle
+ * @return Whether an element was removed (FALSE if the handle was stale)
+ */
+BOOL slot_map_remove(SlotMap *map, SlotHandle handle) {
+	if (slot_map_get(map, handle) == NULL) {
+		return FALSE;
+	}
+
+	SlotHandle *slot = get_elem(map->slots, handle.index);
+	unsigned int dense = slot->index;
+	unsigned int last = map->elements->length - 1;
+
+	if (dense != last) {
+		unsigned int moved_slot = *(unsigned int*) get_elem(map->dense_slots, last);
+		set_elem(map->elements, dense, get_elem(map->elements, last));
+		set_elem(map->dense_slots, dense, &moved_slot);
+		((SlotHandle*) get_elem(map->slots, moved_slot))->index = dense;
+	}
+	map->elements->length--;
+	map->dense_slots->length--;
+
+	slot->generation++;
+	slot->index = map->free_head;
+	map->free_head = handle.index;
+	return TRUE;
+}
+
+/**
+ * The handle of the element at a dense position, for use while iterating over map->elements.
+ *
+ * @param map The slot map
+ * @param dense The position within map->elements
+ * @return The handle to that element
+ */
+SlotHandle slot_map_handle_at(SlotMap *map, int dense) {
+	SlotHandle handle;
+	handle.index = *(unsigned int*) get_elem(map->dense_slots, dense);
+	handle.generation = ((SlotHandle*) get_elem(map->slots, handle.index))->generation;
+
+	return handle;
+}
+
+/**
+ * Memory management: Deallocate a slot map.
+ *
+ * @param map The slot map to deallocate
+ */
+void free_slot_map(SlotMap *map) {
+	free_vector(map->elements);
+	free_vector(map->dense_slots);
+	free_vector(map->slots);
+	free(map);
+}
+
+/**
+ * Walks the minimum or maximum segment tree of a range index over [from, to).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @param minimum Whether to find the minimum rather than the maximum
+ * @return The minimum or maximum
+ */
+static double range_index_query(Vector *vector, size_t from, size_t to, BOOL minimum) {
+	RangeIndex *index = vector->range_index;
+	if (index == NULL) {
+		fprintf(stderr, "ERROR: Attempted a range query on a vector without a range index!\n");
+		return minimum ? INFINITY : -INFINITY;
+	}
+
+	double *tree = minimum ? index->minimums : index->maximums;
+	double result = minimum ? INFINITY : -INFINITY;
+	size_t low = MIN(from, index->size) + index->size;
+	size_t high = MIN(to, index->size) + index->size;
+
+	while (low < high) {
+		if (low & 1) {
+			result = minimum ? fmin(result, tree[low]) : fmax(result, tree[low]);
+			low++;
+		}
+		if (high & 1) {
+			high--;
+			result = minimum ? fmin(result, tree[high]) : fmax(result, tree[high]);
+		}
+		low /= 2;
+		high /= 2;
+	}
+
+	return result;
+}
+
+/**
+ * Reads an element of an integer numeric type (NUMERIC_INT or NUMERIC_LONG) exactly.
+ *
+ * @param type The type of the element
+ * @param element The element
+ * @return The value of the element
+ */
+static long long numeric_integer_value(NumericType type, void *element) {
+	return type == NUMERIC_INT ? *(int*) element : *(long long*) element;
+}
+
+/**
+ * The sum of the first count slots of a range index's integer Fenwick tree.
+ *
+ * @param index The range index (of an integer type)
+ * @param count The amount of slots
+ * @return The (wrapping) sum
+ */
+static unsigned long long range_index_integer_prefix(RangeIndex *index, size_t count) {
+	unsigned long long sum = 0;
+	for (size_t j = count; j > 0; j -= j & -j) {
+		sum += index->integer_sums[j];
+	}
+	return sum;
+}
+
+/**
+ * Attaches a range query index to a numeric vector, answering range sums, minimums and
+ * maximums in O(log n) and updated in O(log n) on every set_elem and push_back.
+ * Replaces any index already attached.
+ *
+ * @param vector The vector
+ * @param type The type of the vector's elements
+ * @return Whether the index was attached (FALSE if type does not match elem_size)
+ */
+BOOL attach_range_index(Vector *vector, NumericType type) {
+	if (numeric_size(type) != vector->elem_size) {
+		fprintf(stderr, "ERROR: Attempted to attach a range index of the wrong numeric type!\n");
+		return FALSE;
+	}
+
+	detach_range_index(vector);
+
+	RangeIndex *index = malloc(sizeof(RangeIndex));
+	index->type = type;
+	index->size = 0;
+	index->sums = NULL;
+	index->integer_sums = NULL;
+	index->minimums = NULL;
+	index->maximums = NULL;
+	vector->range_index = index;
+
+	range_index_rebuild(vector);
+	return TRUE;
+}
+
+/**
+ * Detaches (and deallocates) the range query index of a vector, if it has one.
+ *
+ * @param vector The vector
+ */
+void detach_range_index(Vector *vector) {
+	RangeIndex *index = vector->range_index;
+	if (index == NULL) {
+		return;
+	}
+
+	free(index->sums);
+	free(index->integer_sums);
+	free(index->minimums);
+	free(index->maximums);
+	free(index);
+	vector->range_index = NULL;
+}
+
+/**
+ * Rebuilds the range query index of a vector from scratch in O(n).
+ *
+ * @param vector The vector
+ */
+void range_index_rebuild(Vector *vector) {
+	RangeIndex *index = vector->range_index;
+	BOOL integer = index->type == NUMERIC_INT || index->type == NUMERIC_LONG;
+
+	size_t size = 16;
+	while (size < vector->length) {
+		size *= 2;
+	}
+
+	if (size != index->size) {
+		free(index->sums);
+		free(index->integer_sums);
+		free(index->minimums);
+		free(index->maximums);
+		index->sums = integer ? NULL : malloc((size + 1) * sizeof(double));
+		index->integer_sums = integer ? malloc((size + 1) * sizeof(unsigned long long)) : NULL;
+		index->minimums = malloc(2 * size * sizeof(double));
+		index->maximums = malloc(2 * size * sizeof(double));
+		index->size = size;
+	}
+	index->length = vector->length;
+
+	for (size_t i = 0; i < size; i++) {
+		BOOL present = i < vector->length;
+		double value = present ? numeric_value(index->type, get_elem(vector, i)) : 0;
+
+		if (integer) {
+			index->integer_sums[i + 1] = present ? numeric_integer_value(index->type, get_elem(vector, i)) : 0;
+		} else {
+			index->sums[i + 1] = value;
+		}
+		index->minimums[size + i] = present ? value : INFINITY;
+		index->maximums[size + i] = present ? value : -INFINITY;
+	}
+
+	// Each Fenwick node passes its total on to the next node covering it
+	for (size_t i = 1; i <= size; i++) {
+		size_t parent = i + (i & -i);
+		if (parent > size) {
+			continue;
+		}
+		if (integer) {
+			index->integer_sums[parent] += index->integer_sums[i];
+		} else {
+			index->sums[parent] += index->sums[i];
+		}
+	}
+
+	for (size_t node = size - 1; node >= 1; node--) {
+		index->minimums[node] = fmin(index->minimums[2 * node], index->minimums[2 * node + 1]);
+		index->maximums[node] = fmax(index->maximums[2 * node], index->maximums[2 * node + 1]);
+	}
+}
+
+/**
+ * Brings the range query index of a vector up to date after the elements in [from, to) changed,
+ * and/or its length changed. Called by vector_modified.
+ *
+ * @param vector The vector
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void range_index_update(Vector *vector, size_t from, size_t to) {
+	RangeIndex *index = vector->range_index;
+
+	if (vector->length > index->size) {
+		range_index_rebuild(vector);
+		return;
+	}
+
+	// Any slots between the old and new lengths changed too
+	if (index->length != vector->length) {
+		from = MIN(from, MIN(index->length, vector->length));
+		to = to > index->length ? to : index->length;
+		to = to > vector->length ? to : vector->length;
+	}
+	to = MIN(to, index->size);
+
+	// Past a point one O(n) rebuild beats many O(log n) updates
+	size_t depth = 1;
+	while (((size_t) 1 << depth) < index->size) {
+		depth++;
+	}
+	if (to > from && (to - from) * depth > index->size) {
+		range_index_rebuild(vector);
+		return;
+	}
+
+	for (size_t i = from; i < to; i++) {
+		BOOL present = i < vector->length;
+		double value = present ? numeric_value(index->type, get_elem(vector, i)) : 0;
+
+		if (index->integer_sums != NULL) {
+			// The old value is recovered from the tree itself, since the double leaves may have rounded it
+			unsigned long long integer_value = present ? numeric_integer_value(index->type, get_elem(vector, i)) : 0;
+			unsigned long long integer_old = range_index_integer_prefix(index, i + 1) - range_index_integer_prefix(index, i);
+			for (size_t j = i + 1; j <= index->size; j += j & -j) {
+				index->integer_sums[j] += integer_value - integer_old;
+			}
+		} else {
+			double old = i < index->length ? index->minimums[index->size + i] : 0;
+			for (size_t j = i + 1; j <= index->size; j += j & -j) {
+				index->sums[j] += value - old;
+			}
+		}
+
+		size_t node = index->size + i;
+		index->minimums[node] = present ? value : INFINITY;
+		index->maximums[node] = present ? value : -INFINITY;
+		for (node /= 2; node >= 1; node /= 2) {
+			index->minimums[node] = fmin(index->minimums[2 * node], index->minimums[2 * node + 1]);
+			index->maximums[node] = fmax(index->maximums[2 * node], index->maximums[2 * node + 1]);
+		}
+	}
+
+	index->length = vector->length;
+}
+
+/**
+ * The sum of the elements in [from, to) of a vector with a range index (O(log n)).
+ * Float and double sums are updated incrementally, so rounding error can build up over many
+ * updates (range_index_rebuild recomputes them); integer sums are exact (see range_sum_integer).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @return The sum
+ */
+double range_sum(Vector *vector, size_t from, size_t to) {
+	RangeIndex *index = vector->range_index;
+	if (index == NULL) {
+		fprintf(stderr, "ERROR: Attempted a range query on a vector without a range index!\n");
+		return 0;
+	}
+	if (index->integer_sums != NULL) {
+		return range_sum_integer(vector, from, to);
+	}
+
+	double sum = 0;
+	for (size_t j = MIN(to, index->length); j > 0; j -= j & -j) {
+		sum += index->sums[j];
+	}
+	for (size_t j = MIN(from, index->length); j > 0; j -= j & -j) {
+		sum -= index->sums[j];
+	}
+	return sum;
+}
+
+/**
+ * The exact sum of the elements in [from, to) of an int or long vector with a range index (O(log n)).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @return The sum (wrapped, as long long arithmetic would, if it does not fit)
+ */
+long long range_sum_integer(Vector *vector, size_t from, size_t to) {
+	RangeIndex *index = vector->range_index;
+	if (index == NULL || index->integer_sums == NULL) {
+		fprintf(stderr, "ERROR: Attempted an integer range sum on a vector without an integer range index!\n");
+		return 0;
+	}
+
+	unsigned long long sum = range_index_integer_prefix(index, MIN(to, index->length))
+			- range_index_integer_prefix(index, MIN(from, index->length));
+	return (long long) sum;
+}
+
+/**
+ * The smallest element in [from, to) of a vector with a range index (O(log n)).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @return The minimum, or +INFINITY for an empty range
+ */
+double range_min(Vector *vector, size_t from, size_t to) {
+	return range_index_query(vector, from, to, TRUE);
+}
+
+/**
+ * The largest element in [from, to) of a vector with a range index (O(log n)).
+ *
+ * @param vector The vector
+ * @param from The first index of the range
+ * @param to One past the last index of the range
+ * @return The maximum, or -INFINITY for an empty range
+ */
+double range_max(Vector *vector, size_t from, size_t to) {
+	return range_index_query(vector, from, to, FALSE);
+}
+
+
+/**
+ * Attaches a zone map to a numeric vector, summarising every block of block_size elements
+ * with its min, max and count. It is kept up to date by push_back, set_elem and friends,
+ * and lets index_of and filter_range skip blocks which cannot match.
+ * Replaces any zone map already attached.
+ *
+ * @param vector The vector
+ * @param type The type of the vector's elements
+ * @param block_size The amount of elements per block (eg. ZONE_MAP_BLOCK_SIZE)
+ * @return Whether the zone map was attached (FALSE if type does not match elem_size)
+ */
+BOOL attach_zone_map(Vector *vector, NumericType type, size_t block_size) {
+	if (numeric_size(type) != vector->elem_size || block_size == 0) {
+		fprintf(stderr, "ERROR: Attempted to attach a zone map of the wrong numeric type or block size!\n");
+		return FALSE;
+	}
+
+	detach_zone_map(vector);
+
+	ZoneMap *zone_map = malloc(sizeof(ZoneMap));
+	zone_map->type = type;
+	zone_map->block_size = block_size;
+	zone_map->length = 0;
+	zone_map->zones = create_vector(sizeof(Zone));
+	vector->zone_map = zone_map;
+
+	zone_map_update(vector, 0, vector->length);
+	return TRUE;
+}
+
+/**
+ * Detaches (and deallocates) the zone map of a vector, if it has one.
+ *
+ * @param vector The vector
+ */
+void detach_zone_map(Vector *vector) {
+	if (vector->zone_map == NULL) {
+		return;
+	}
+
+	free_vector(vector->zone_map->zones);
+	free(vector->zone_map);
+	vector->zone_map = NULL;
+}
+
+/**
+ * Brings the zone map of a vector up to date after the elements in [from, to) changed,
+ * and/or its length changed. Called by vector_modified.
+ * A single changed element only widens its zone; anything else resummarises the blocks it touches.
+ *
+ * @param vector The vector
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void zone_map_update(Vector *vector, size_t from, size_t to) {
+	ZoneMap *zone_map = vector->zone_map;
+	size_t block_size = zone_map->block_size;
+	Vector *zones = zone_map->zones;
+
+	// Writes over existing elements, or appends, of one element just widen a zone
+	BOOL appended = vector->length == zone_map->length + 1 && from == zone_map->length;
+	if (to == from + 1 && (appended || (vector->length == zone_map->length && to <= vector->length))) {
+		size_t block = from / block_size;
+		double value = numeric_value(zone_map->type, get_elem(vector, from));
+
+		if (block == zones->length) {
+			Zone zone = { value, value, 0 };
+			push_back(zones, &zone);
+		}
+
+		Zone *zone = get_elem(zones, block);
+		zone->min = fmin(zone->min, value);
+		zone->max = fmax(zone->max, value);
+		if (appended) {
+			zone->count++;
+		}
+		zone_map->length = vector->length;
+		return;
+	}
+
+	if (zone_map->length != vector->length) {
+		from = MIN(from, MIN(zone_map->length, vector->length));
+		to = vector->length;
+	}
+	to = MIN(to, vector->length);
+
+	size_t blocks = (vector->length + block_size - 1) / block_size;
+	reserve_vector(zones, blocks);
+	zones->length = blocks;
+
+	size_t last_block = MIN(blocks, (MAX(to, from + 1) + block_size - 1) / block_size);
+	for (size_t block = from / block_size; block < last_block; block++) {
+		size_t start = block * block_size;
+		size_t end = MIN(start + block_size, vector->length);
+		Zone *zone = get_elem(zones, block);
+
+		zone->min = INFINITY;
+		zone->max = -INFINITY;
+		zone->count = end - start;
+		for (size_t i = start; i < end; i++) {
+			double value = numeric_value(zone_map->type, get_elem(vector, i));
+			zone->min = fmin(zone->min, value);
+			zone->max = fmax(zone->max, value);
+		}
+	}
+
+	zone_map->length = vector->length;
+}
+
+/**
+ * Finds the index of every element of a zone mapped vector within [low, high],
+ * scanning only the blocks whose zones overlap that range.
+ *
+ * @param vector The vector with a zone map
+ * @param low The inclusive lower bound
+ * @param high The inclusive upper bound
+ * @return A new vector of int holding the matching indexes in ascending order
+ */
+Vector* filter_range(Vector *vector, double low, double high) {
+	ZoneMap *zone_map = vector->zone_map;
+	Vector *matches = create_vector(sizeof(int));
+
+	if (zone_map == NULL) {
+		fprintf(stderr, "ERROR: Attempted a range filter on a vector without a zone map!\n");
+		return matches;
+	}
+
+	for (size_t block = 0; block < zone_map->zones->length; block++) {
+		Zone *zone = get_elem(zone_map->zones, block);
+		if (zone->max < low || zone->min > high) {
+			continue;
+		}
+
+		size_t start = block * zone_map->block_size;
+		size_t end = start + zone->count;
+		for (size_t i = start; i < end; i++) {
+			double value = numeric_value(zone_map->type, get_elem(vector, i));
+			if (value >= low && value <= high) {
+				int index = i;
+				push_back(matches, &index);
+			}
+		}
+	}
+
+	return matches;
+}
+
+/**
+ * index_of for a vector with a zone map: only blocks whose [min, max] holds the element are scanned.
+ *
+ * @param vector The vector with a zone map
+ * @param element The data to search for
+ * @return The index of the found element, or -1 if it does not exist
+ */
+int zone_map_index_of(Vector *vector, void *element) {
+	ZoneMap *zone_map = vector->zone_map;
+	double value = numeric_value(zone_map->type, element);
+
+	for (size_t block = 0; block < zone_map->zones->length; block++) {
+		Zone *zone = get_elem(zone_map->zones, block);
+
+		// NaN compares false against everything, so it never rules a block out
+		if (value < zone->min || value > zone->max) {
+			continue;
+		}
+
+		size_t start = block * zone_map->block_size;
+		for (size_t i = start; i < start + zone->count; i++) {
+			if (memcmp(get_elem(vector, i), element, vector->elem_size) == 0) {
+				return i;
+			}
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Works out the block and bits an element maps to in a Bloom filter.
+ *
+ * @param bloom The Bloom filter
+ * @param element The element
+ * @param elem_size The size of the element
+ * @param block Set to the first word of the element's block
+ * @param bits Filled with the 8 word mask of the element's bits within its block
+ */
+static void bloom_filter_bits(BloomFilter *bloom, void *element, size_t elem_size,
+		unsigned long long **block, unsigned long long *bits) {
+	unsigned long long hash = hash_bytes(element, elem_size);
+	unsigned long long spread = hash * 0x9E3779B97F4A7C15ULL;
+
+	*block = bloom->bits + (hash >> 32) % bloom->block_count * 8;
+	memset(bits, 0, 8 * sizeof(unsigned long long));
+
+	// Each bit position within the 512 bit block takes 9 bits of the spread hash
+	for (int i = 0; i < BLOOM_HASHES; i++) {
+		unsigned int position = (spread >> (i * 9)) & 511;
+		bits[position / 64] |= 1ULL << (position % 64);
+	}
+}
+
+/**
+ * Adds an element to a Bloom filter.
+ *
+ * @param bloom The Bloom filter
+ * @param element The element
+ * @param elem_size The size of the element
+ */
+static void bloom_filter_add(BloomFilter *bloom, void *element, size_t elem_size) {
+	unsigned long long *block;
+	unsigned long long bits[8];
+
+	bloom_filter_bits(bloom, element, elem_size, &block, bits);
+	for (int i = 0; i < 8; i++) {
+		block[i] |= bits[i];
+	}
+	bloom->inserted++;
+}
+
+/**
+ * Attaches a blocked Bloom filter to a vector, kept up to date by push_back, set_elem and friends,
+ * so index_of and contains can reject most missing elements without scanning.
+ * Replaces any Bloom filter already attached.
+ *
+ * @param vector The vector
+ */
+void attach_bloom_filter(Vector *vector) {
+	detach_bloom_filter(vector);
+
+	BloomFilter *bloom = malloc(sizeof(BloomFilter));
+	bloom->bits = NULL;
+	bloom->block_count = 0;
+	vector->bloom = bloom;
+
+	bloom_filter_rebuild(vector);
+}
+
+/**
+ * Detaches (and deallocates) the Bloom filter of a vector, if it has one.
+ *
+ * @param vector The vector
+ */
+void detach_bloom_filter(Vector *vector) {
+	if (vector->bloom == NULL) {
+		return;
+	}
+
+	free(vector->bloom->bits);
+	free(vector->bloom);
+	vector->bloom = NULL;
+}
+
+/**
+ * Rebuilds the Bloom filter of a vector from its current elements, sized for twice as many,
+ * clearing out any false positives left behind by removed or overwritten elements.
+ * Happens automatically once the filter fills up or half of it has gone stale.
+ *
+ * @param vector The vector
+ */
+void bloom_filter_rebuild(Vector *vector) {
+	BloomFilter *bloom = vector->bloom;
+
+	size_t capacity = MAX(vector->length * 2, 1024);
+	size_t block_count = (capacity * BLOOM_BITS_PER_ELEM + 511) / 512;
+
+	if (block_count != bloom->block_count) {
+		free(bloom->bits);
+		bloom->bits = malloc(block_count * 8 * sizeof(unsigned long long));
+		bloom->block_count = block_count;
+	}
+	memset(bloom->bits, 0, block_count * 8 * sizeof(unsigned long long));
+	bloom->capacity = capacity;
+	bloom->inserted = 0;
+	bloom->stale = 0;
+	bloom->length = vector->length;
+
+	for (size_t i = 0; i < vector->length; i++) {
+		bloom_filter_add(bloom, get_elem(vector, i), vector->elem_size);
+	}
+}
+
+/**
+ * Brings the Bloom filter of a vector up to date after the elements in [from, to) changed,
+ * and/or its length changed. Called by vector_modified.
+ *
+ * @param vector The vector
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void bloom_filter_update(Vector *vector, size_t from, size_t to) {
+	BloomFilter *bloom = vector->bloom;
+
+	if (vector->length < bloom->length) {
+		// A removal only shifts elements already in the filter
+		bloom->stale += bloom->length - vector->length;
+	} else if (vector->length == bloom->length + 1 && to == vector->length) {
+		// A single insert (or push_back) shifts everything after the new element at from
+		bloom_filter_add(bloom, get_elem(vector, from), vector->elem_size);
+	} else {
+		if (vector->length == bloom->length) {
+			bloom->stale += to - from;
+		}
+		for (size_t i = from; i < MIN(to, vector->length); i++) {
+			bloom_filter_add(bloom, get_elem(vector, i), vector->elem_size);
+		}
+	}
+	bloom->length = vector->length;
+
+	if (bloom->inserted > bloom->capacity || bloom->stale > MAX(vector->length, 1024) / 2) {
+		bloom_filter_rebuild(vector);
+	}
+}
+
+/**
+ * Whether a vector's Bloom filter allows that it may hold an element.
+ * FALSE is definite, TRUE may be a false positive.
+ *
+ * @param vector The vector with a Bloom filter
+ * @param element The data to test for
+ * @return Whether the element may be in the vector
+ */
+BOOL bloom_filter_may_contain(Vector *vector, void *element) {
+	BloomFilter *bloom = vector->bloom;
+	unsigned long long *block;
+	unsigned long long bits[8];
+
+	bloom_filter_bits(bloom, element, vector->elem_size, &block, bits);
+	for (int i = 0; i < 8; i++) {
+		if ((block[i] & bits[i]) != bits[i]) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * Finds the table slot holding an element, or the empty slot where it would go.
+ *
+ * @param interned The interning vector
+ * @param element The element to look for
+ * @return The slot index
+ */
+static size_t intern_find_slot(InternVector *interned, void *element) {
+	Vector *elements = interned->elements;
+	unsigned int *table = interned->table->array;
+	size_t mask = interned->table->length - 1;
+	size_t slot = hash_bytes(element, elements->elem_size) & mask;
+
+	while (table[slot] != 0
+			&& memcmp(get_elem(elements, table[slot] - 1), element, elements->elem_size) != 0) {
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+/**
+ * Doubles the hash table of an interning vector, reinserting every element.
+ *
+ * @param interned The interning vector
+ */
+static void intern_grow_table(InternVector *interned) {
+	size_t size = interned->table->length * 2;
+
+	free_vector(interned->table);
+	interned->table = create_vector_with_capacity(sizeof(unsigned int), size);
+	interned->table->length = interned->table->capacity;
+
+	for (size_t i = 0; i < interned->elements->length; i++) {
+		unsigned int *entry = get_elem(interned->table, intern_find_slot(interned, get_elem(interned->elements, i)));
+		*entry = i + 1;
+	}
+}
+
+/**
+ * Create a new, empty interning vector.
+ *
+ * @param elem_size The size of each element in the vector
+ * @return The generated interning vector
+ */
+InternVector* create_intern_vector(size_t elem_size) {
+	InternVector *interned = malloc(sizeof(InternVector));
+	interned->elements = create_vector(elem_size);
+	interned->table = create_vector_with_capacity(sizeof(unsigned int), 64);
+	interned->table->length = interned->table->capacity;
+
+	return interned;
+}
+
+/**
+ * Interns an element: returns the index it already has, or pushes it to the back and
+ * returns its new index (O(1) expected). Indexes never change.
+ *
+ * @param interned The interning vector
+ * @param element The element to intern
+ * @return The index of the element
+ */
+int intern(InternVector *interned, void *element) {
+	size_t slot = intern_find_slot(interned, element);
+	unsigned int *entry = get_elem(interned->table, slot);
+
+	if (*entry != 0) {
+		return *entry - 1;
+	}
+
+	push_back(interned->elements, element);
+	*entry = interned->elements->length;
+
+	// Keep the table at most half full so probe runs stay short
+	if (interned->elements->length * 2 > interned->table->length) {
+		intern_grow_table(interned);
+	}
+	return interned->elements->length - 1;
+}
+
+/**
+ * Looks up the index of an element without interning it (O(1) expected).
+ *
+ * @param interned The interning vector
+ * @param element The element to search for
+ * @return The index of the element, or -1 if it has not been interned
+ */
+int intern_index_of(InternVector *interned, void *element) {
+	unsigned int *entry = get_elem(interned->table, intern_find_slot(interned, element));
+	return (int) *entry - 1;
+}
+
+/**
+ * Memory management: Deallocate an interning vector.
+ *
+ * @param interned The interning vector to deallocate
+ */
+void free_intern_vector(InternVector *interned) {
+	free_vector(interned->elements);
+	free_vector(interned->table);
+	free(interned);
+}
+
+/**
+ * Fills in a zero padded VectorFileHeader describing a vector.
+ *
+ * @param vector The vector
+ * @param header_bytes The VECTOR_FILE_HEADER_SIZE bytes to fill
+ * @param checksum Whether to checksum the data (otherwise the checksum is left 0)
+ */
+static void vector_file_header(Vector *vector, char *header_bytes, BOOL checksum) {
+	memset(header_bytes, 0, VECTOR_FILE_HEADER_SIZE);
+
+	VectorFileHeader *header = (VectorFileHeader*) header_bytes;
+	memcpy(header->magic, VECTOR_FILE_MAGIC, sizeof(header->magic));
+	header->version = VECTOR_FILE_VERSION;
+	header->endianness = 0x01020304;
+	header->elem_size = vector->elem_size;
+	header->length = vector->length;
+	header->capacity = vector->length;
+	header->checksum = checksum ? hash_bytes(vector->array, vector->length * vector->elem_size) : 0;
+}
+
+/**
+ * Whether a VectorFileHeader can be loaded on this machine, complaining if not.
+ *
+ * @param header The header
+ * @return Whether it is valid
+ */
+static BOOL vector_file_header_valid(VectorFileHeader *header) {
+	if (memcmp(header->magic, VECTOR_FILE_MAGIC, sizeof(header->magic)) != 0) {
+		fprintf(stderr, "ERROR: Not a vector file!\n");
+		return FALSE;
+	}
+	if (header->version != VECTOR_FILE_VERSION) {
+		fprintf(stderr, "ERROR: Unsupported vector file version %u!\n", header->version);
+		return FALSE;
+	}
+	if (header->endianness != 0x01020304) {
+		fprintf(stderr, "ERROR: Vector file was written on a machine of different endianness!\n");
+		return FALSE;
+	}
+	if (header->elem_size == 0 || header->length > header->capacity
+			|| header->capacity > (SIZE_MAX - VECTOR_FILE_HEADER_SIZE) / header->elem_size) {
+		fprintf(stderr, "ERROR: Vector file header is corrupt!\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Whether the data a valid VectorFileHeader describes can still be in a file, complaining if not.
+ * Only regular files have a size to check against, anything else (eg. a pipe) passes.
+ *
+ * @param fd The file descriptor of the file
+ * @param header The header
+ * @param data_offset The offset in the file the header's data starts at
+ * @param regular Set to whether the file is a regular file (may be NULL)
+ * @return Whether the file is long enough to hold the data
+ */
+static BOOL vector_file_data_fits(int fd, VectorFileHeader *header, off_t data_offset, BOOL *regular) {
+	struct stat status;
+	BOOL checkable = fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && data_offset >= 0;
+	if (regular != NULL) {
+		*regular = checkable;
+	}
+
+	if (checkable && (status.st_size < data_offset
+			|| header->length * header->elem_size > (size_t) (status.st_size - data_offset))) {
+		fprintf(stderr, "ERROR: Vector file is truncated!\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Reads exactly count bytes from a file descriptor, retrying short reads.
+ *
+ * @param fd The file descriptor
+ * @param buffer Where to read into
+ * @param count The amount of bytes to read
+ * @return Whether all of them were read (FALSE on error or end of file)
+ */
+static BOOL read_fully(int fd, void *buffer, size_t count) {
+	size_t done = 0;
+
+	while (done < count) {
+		ssize_t result = read(fd, buffer + done, MIN(count - done, VECTOR_IO_CHUNK));
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+		if (result <= 0) {
+			return FALSE;
+		}
+		done += result;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Writes a vector to an open file descriptor: a VectorFileHeader followed by the raw array,
+ * written with as few (vectored) system calls as possible.
+ *
+ * @param vector The vector to write
+ * @param fd The file descriptor to write to (from its current position)
+ * @return Whether the whole vector was written
+ */
+BOOL vector_write_fd(Vector *vector, int fd) {
+	char header_bytes[VECTOR_FILE_HEADER_SIZE];
+	vector_file_header(vector, header_bytes, TRUE);
+
+	size_t data_bytes = vector->length * vector->elem_size;
+
+	// Header and array go out together, chunked only because single writes are capped
+	size_t written = 0;
+	size_t total = VECTOR_FILE_HEADER_SIZE + data_bytes;
+	while (written < total) {
+		struct iovec remaining[2];
+		int count = 0;
+
+		if (written < VECTOR_FILE_HEADER_SIZE) {
+			remaining[count].iov_base = header_bytes + written;
+			remaining[count].iov_len = VECTOR_FILE_HEADER_SIZE - written;
+			count++;
+		}
+		size_t data_done = written > VECTOR_FILE_HEADER_SIZE ? written - VECTOR_FILE_HEADER_SIZE : 0;
+		if (data_done < data_bytes) {
+			remaining[count].iov_base = vector->array + data_done;
+			remaining[count].iov_len = MIN(data_bytes - data_done, VECTOR_IO_CHUNK);
+			count++;
+		}
+
+		ssize_t result = writev(fd, remaining, count);
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "ERROR: Failed to write vector: %s\n", strerror(errno));
+			return FALSE;
+		}
+		written += result;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Reads a vector written by vector_write_fd from an open file descriptor,
+ * straight into a single allocation of the right size.
+ *
+ * @param fd The file descriptor to read from (from its current position)
+ * @return The loaded vector, or NULL if the data is missing, corrupt or from an incompatible machine
+ */
+Vector* vector_read_fd(int fd) {
+	char header_bytes[VECTOR_FILE_HEADER_SIZE];
+	if (!read_fully(fd, header_bytes, VECTOR_FILE_HEADER_SIZE)) {
+		fprintf(stderr, "ERROR: Failed to read vector header!\n");
+		return NULL;
+	}
+
+	VectorFileHeader *header = (VectorFileHeader*) header_bytes;
+	BOOL regular;
+	if (!vector_file_header_valid(header) || !vector_file_data_fits(fd, header, lseek(fd, 0, SEEK_CUR), &regular)) {
+		return NULL;
+	}
+
+	// Sized exactly (not to the next power of 2), since loaded vectors are often huge and read mostly.
+	// The length of a pipe cannot be checked up front, so its array grows as the data actually arrives.
+	size_t elem_size = header->elem_size;
+	size_t capacity = regular ? header->length : MIN(header->length, MAX(VECTOR_STREAM_CHUNK / elem_size, 1));
+	Vector *vector = create_vector_with_capacity(elem_size, 0);
+	expand_vector(vector, MAX(capacity, 1));
+
+	while (vector->length < header->length) {
+		if (vector->length == vector->capacity) {
+			expand_vector(vector, MIN(vector->capacity * 2, header->length));
+		}
+
+		size_t count = vector->capacity - vector->length;
+		if (!read_fully(fd, vector->array + vector->length * elem_size, count * elem_size)) {
+			fprintf(stderr, "ERROR: Vector file is truncated!\n");
+			free_vector(vector);
+			return NULL;
+		}
+		vector->length += count;
+	}
+
+	size_t data_bytes = header->length * elem_size;
+
+	if (header->checksum != 0 && hash_bytes(vector->array, data_bytes) != header->checksum) {
+		fprintf(stderr, "ERROR: Vector file checksum mismatch, the file is corrupt!\n");
+		free_vector(vector);
+		return NULL;
+	}
+
+	return vector;
+}
+
+/**
+ * Saves a vector to a file (see vector_write_fd), replacing anything already there.
+ *
+ * @param vector The vector to save
+ * @param path The path of the file
+ * @return Whether the vector was saved
+ */
+BOOL vector_save(Vector *vector, const char *path) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s for writing: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+
+	BOOL saved = vector_write_fd(vector, fd);
+	if (close(fd) != 0) {
+		fprintf(stderr, "ERROR: Failed to close %s: %s\n", path, strerror(errno));
+		saved = FALSE;
+	}
+	return saved;
+}
+
+/**
+ * Loads a vector saved by vector_save.
+ *
+ * @param path The path of the file
+ * @return The loaded vector, or NULL if the file could not be read or is invalid
+ */
+Vector* vector_load(const char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s for reading: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	Vector *vector = vector_read_fd(fd);
+	close(fd);
+	return vector;
+}
+
+/**
+ * Writes exactly count bytes to a file descriptor, retrying short writes.
+ *
+ * @param fd The file descriptor
+ * @param buffer The bytes to write
+ * @param count The amount of bytes to write
+ * @return Whether all of them were written
+ */
+static BOOL write_fully(int fd, const void *buffer, size_t count) {
+	size_t done = 0;
+
+	while (done < count) {
+		ssize_t result = write(fd, buffer + done, MIN(count - done, VECTOR_IO_CHUNK));
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+		if (result <= 0) {
+			return FALSE;
+		}
+		done += result;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Maps an open vector file into memory as a vector (taking ownership of fd).
+ *
+ * @param fd The file descriptor, open for reading (and writing unless read_only)
+ * @param read_only Whether to map the file read only
+ * @return The vector, or NULL if the file is invalid (fd is closed)
+ */
+static Vector* map_vector_fd(int fd, BOOL read_only) {
+	struct stat status;
+	VectorFileHeader header;
+
+	if (fstat(fd, &status) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		fprintf(stderr, "ERROR: Failed to read vector header!\n");
+		close(fd);
+		return NULL;
+	}
+	if (!vector_file_header_valid(&header)) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t bytes = VECTOR_FILE_HEADER_SIZE + header.capacity * header.elem_size;
+	if ((size_t) status.st_size < bytes) {
+		fprintf(stderr, "ERROR: Vector file is truncated!\n");
+		close(fd);
+		return NULL;
+	}
+
+	int protection = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+	void *base = mmap(NULL, bytes, protection, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Failed to map vector file: %s\n", strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	MappedFile *mapping = malloc(sizeof(MappedFile));
+	mapping->fd = fd;
+	mapping->base = base;
+	mapping->bytes = bytes;
+	mapping->read_only = read_only;
+	mapping->shared = FALSE;
+
+	// The data is about to change in place, so any saved checksum no longer applies
+	if (!read_only) {
+		((VectorFileHeader*) base)->checksum = 0;
+	}
+
+	Vector *vector = create_vector_with_capacity(header.elem_size, 0);
+	free(vector->array);
+	vector->array = base + VECTOR_FILE_HEADER_SIZE;
+	vector->length = header.length;
+	vector->capacity = header.capacity;
+	vector->mapping = mapping;
+
+	return vector;
+}
+
+
+/**
+ * Creates a new vector whose array is a memory mapping of a (new or truncated) file,
+ * so its contents persist without ever being saved. The file uses the vector_save format.
+ *
+ * @param path The path of the file
+ * @param elem_size The size of each element in the vector
+ * @param initial_size The capacity to create the file with
+ * @return The generated vector, or NULL if the file could not be created
+ */
+Vector* create_mapped_vector(const char *path, size_t elem_size, size_t initial_size) {
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to create %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	Vector *empty = create_vector_with_capacity(elem_size, 0);
+	char header_bytes[VECTOR_FILE_HEADER_SIZE];
+	vector_file_header(empty, header_bytes, FALSE);
+	free_vector(empty);
+
+	if (!write_fully(fd, header_bytes, VECTOR_FILE_HEADER_SIZE)) {
+		fprintf(stderr, "ERROR: Failed to write the header of %s: %s\n", path, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	Vector *vector = map_vector_fd(fd, FALSE);
+	if (vector != NULL) {
+		expand_vector(vector, MAX(initial_size, 1));
+	}
+	return vector;
+}
+
+/**
+ * Opens a vector file (from create_mapped_vector or vector_save) as a memory mapped vector.
+ * Nothing is read up front: pages are loaded as they are touched, and changes are written back to the file.
+ *
+ * @param path The path of the file
+ * @return The vector, or NULL if the file could not be opened or is invalid
+ */
+Vector* open_mapped_vector(const char *path) {
+	int fd = open(path, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	return map_vector_fd(fd, FALSE);
+}
+
+/**
+ * Flushes the changes to a memory mapped vector to its file, blocking until they are on disk.
+ *
+ * @param vector The memory mapped vector
+ * @return Whether the flush succeeded
+ */
+BOOL sync_vector(Vector *vector) {
+	if (vector->mapping == NULL) {
+		fprintf(stderr, "ERROR: Attempted to sync a vector which is not memory mapped!\n");
+		return FALSE;
+	}
+	if (vector->mapping->read_only) {
+		return TRUE;
+	}
+
+	((VectorFileHeader*) vector->mapping->base)->length = vector->length;
+	if (msync(vector->mapping->base, vector->mapping->bytes, MS_SYNC) != 0) {
+		fprintf(stderr, "ERROR: Failed to sync vector: %s\n", strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Opens a file saved by vector_save as a read only vector pointing straight at the file's pages
+ * (nothing is copied or read up front, and processes opening the same file share the page cache).
+ * Every call which would modify it fails with an error; clone it for a private, writable copy.
+ * The checksum is not verified, since that would read the whole file.
+ *
+ * @param path The path of the file
+ * @return The read only vector, or NULL if the file could not be opened or is invalid
+ */
+Vector* open_readonly_vector(const char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	return map_vector_fd(fd, TRUE);
+}
+
+/**
+ * Unmaps a memory mapped vector and closes its file (free_vector does this itself).
+ * The vector's array is left NULL.
+ *
+ * @param vector The memory mapped vector
+ */
+void unmap_vector(Vector *vector) {
+	MappedFile *mapping = vector->mapping;
+	if (mapping == NULL) {
+		return;
+	}
+
+	if (!mapping->read_only) {
+		((VectorFileHeader*) mapping->base)->length = vector->length;
+	}
+	munmap(mapping->base, mapping->bytes);
+	close(mapping->fd);
+	free(mapping);
+
+	vector->mapping = NULL;
+	vector->array = NULL;
+	vector->length = 0;
+	vector->capacity = 0;
+}
+
+/**
+ * Grows the file behind a memory mapped vector and remaps it (expand_vector does this itself).
+ * Shared memory vectors cannot grow past the capacity they reserved.
+ *
+ * @param vector The memory mapped vector
+ * @param new_size The capacity to grow to
+ */
+void expand_mapped_vector(Vector *vector, size_t new_size) {
+	MappedFile *mapping = vector->mapping;
+
+	// Other processes have the segment mapped, so it can neither move nor shrink
+	if (mapping->shared) {
+		if (new_size > vector->capacity) {
+			fprintf(stderr, "ERROR: Shared vector outgrew its reserved capacity of %zu! Exiting...\n", vector->capacity);
+			exit(1);
+		}
+		return;
+	}
+	size_t new_bytes = VECTOR_FILE_HEADER_SIZE + new_size * vector->elem_size;
+
+	if (ftruncate(mapping->fd, new_bytes) != 0) {
+		fprintf(stderr, "ERROR: Mapped vector expansion failed, possibly out of disk? Exiting...\n");
+		exit(1);
+	}
+
+	void *base = mremap(mapping->base, mapping->bytes, new_bytes, MREMAP_MAYMOVE);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Mapped vector remap failed, possibly out of address space? Exiting...\n");
+		exit(1);
+	}
+
+	mapping->base = base;
+	mapping->bytes = new_bytes;
+	((VectorFileHeader*) base)->capacity = new_size;
+
+	vector->array = base + VECTOR_FILE_HEADER_SIZE;
+	vector->capacity = new_size;
+}
+
+/**
+ * Writes the header which starts a vector stream.
+ *
+ * @param fd The file descriptor to write to
+ * @param elem_size The size of each element
+ * @return Whether it was written
+ */
+static BOOL vector_stream_write_header(int fd, size_t elem_size) {
+	VectorStreamHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, VECTOR_STREAM_MAGIC, sizeof(header.magic));
+	header.version = VECTOR_FILE_VERSION;
+	header.endianness = 0x01020304;
+	header.elem_size = elem_size;
+
+	if (!write_fully(fd, &header, sizeof(header))) {
+		fprintf(stderr, "ERROR: Failed to write vector stream: %s\n", strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Writes one framed chunk of a vector stream (0 elements ends the stream).
+ *
+ * @param fd The file descriptor to write to
+ * @param elements The elements of the chunk
+ * @param count The amount of elements
+ * @param elem_size The size of each element
+ * @return Whether it was written
+ */
+static BOOL vector_stream_write_chunk(int fd, void *elements, size_t count, size_t elem_size) {
+	StreamChunkHeader chunk = { count, count > 0 ? hash_bytes(elements, count * elem_size) : 0 };
+
+	if (!write_fully(fd, &chunk, sizeof(chunk)) || (count > 0 && !write_fully(fd, elements, count * elem_size))) {
+		fprintf(stderr, "ERROR: Failed to write vector stream: %s\n", strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * The background half of vector_stream_consume: reads chunks into whichever buffer is free.
+ *
+ * @param argument The StreamReader
+ * @return NULL
+ */
+static void* stream_reader_thread(void *argument) {
+	StreamReader *reader = argument;
+
+	for (int current = 0; ; current = 1 - current) {
+		pthread_mutex_lock(&reader->lock);
+		while (reader->full[current] && !reader->stopped) {
+			pthread_cond_wait(&reader->changed, &reader->lock);
+		}
+		BOOL stopped = reader->stopped;
+		pthread_mutex_unlock(&reader->lock);
+
+		if (stopped) {
+			return NULL;
+		}
+
+		StreamChunkHeader chunk;
+		size_t bytes = 0;
+		BOOL ok = read_fully(reader->fd, &chunk, sizeof(chunk));
+
+		if (ok && (chunk.count > VECTOR_STREAM_MAX_CHUNK / reader->elem_size)) {
+			fprintf(stderr, "ERROR: Vector stream chunk is too large, the stream is corrupt!\n");
+			ok = FALSE;
+		}
+		if (ok) {
+			bytes = chunk.count * reader->elem_size;
+			if (bytes > reader->capacities[current]) {
+				free(reader->buffers[current]);
+				reader->buffers[current] = malloc(bytes);
+				reader->capacities[current] = bytes;
+			}
+			ok = read_fully(reader->fd, reader->buffers[current], bytes);
+		}
+		if (ok && chunk.count > 0 && hash_bytes(reader->buffers[current], bytes) != chunk.checksum) {
+			fprintf(stderr, "ERROR: Vector stream chunk checksum mismatch, the stream is corrupt!\n");
+			ok = FALSE;
+		}
+
+		pthread_mutex_lock(&reader->lock);
+		if (ok) {
+			reader->counts[current] = chunk.count;
+			reader->full[current] = TRUE;
+		} else {
+			reader->failed = TRUE;
+		}
+		pthread_cond_broadcast(&reader->changed);
+		pthread_mutex_unlock(&reader->lock);
+
+		if (!ok || chunk.count == 0) {
+			return NULL;
+		}
+	}
+}
+
+/**
+ * Appends a chunk of a stream to a vector (the consumer behind vector_stream_read).
+ *
+ * @param elements The elements of the chunk
+ * @param count The amount of elements
+ * @param elem_size The size of each element
+ * @param context A Vector** which is created by the first chunk
+ */
+static void stream_append(void *elements, size_t count, size_t elem_size, void *context) {
+	Vector **target = context;
+
+	if (*target == NULL) {
+		*target = create_vector_with_capacity(elem_size, count);
+	}
+
+	Vector *vector = *target;
+	if (!reserve_vector(vector, vector->length + count)) {
+		return;
+	}
+	memcpy(get_elem(vector, vector->length), elements, count * elem_size);
+	vector->length += count;
+	vector_modified(vector, vector->length - count, vector->length);
+}
+
+/**
+ * Streams elements from a producer callback to a file descriptor (eg. a pipe) as framed chunks,
+ * so the whole sequence never has to be held in memory.
+ *
+ * @param fd The file descriptor to write to
+ * @param elem_size The size of each element
+ * @param chunk_size The maximum amount of elements per chunk (eg. VECTOR_STREAM_CHUNK / elem_size)
+ * @param produce The function pointer filling buffer with up to max elements, returning how many (0 when done)
+ * @param context Passed through untouched to every call of produce
+ * @return Whether everything was written
+ */
+BOOL vector_stream_produce(int fd, size_t elem_size, size_t chunk_size,
+		size_t (*produce)(void *buffer, size_t max, void *context), void *context) {
+	if (chunk_size == 0 || chunk_size * elem_size > VECTOR_STREAM_MAX_CHUNK) {
+		fprintf(stderr, "ERROR: Vector stream chunk size must be between 1 and %d bytes!\n", VECTOR_STREAM_MAX_CHUNK);
+		return FALSE;
+	}
+	if (!vector_stream_write_header(fd, elem_size)) {
+		return FALSE;
+	}
+
+	void *buffer = malloc(chunk_size * elem_size);
+	BOOL ok = TRUE;
+
+	while (ok) {
+		size_t count = produce(buffer, chunk_size, context);
+		ok = vector_stream_write_chunk(fd, buffer, MIN(count, chunk_size), elem_size);
+		if (count == 0) {
+			break;
+		}
+	}
+
+	free(buffer);
+	return ok;
+}
+
+/**
+ * Streams a vector to a file descriptor as framed chunks.
+ *
+ * @param vector The vector to stream
+ * @param fd The file descriptor to write to
+ * @return Whether everything was written
+ */
+BOOL vector_stream_write(Vector *vector, int fd) {
+	size_t chunk_size = MAX(VECTOR_STREAM_CHUNK / vector->elem_size, 1);
+	if (!vector_stream_write_header(fd, vector->elem_size)) {
+		return FALSE;
+	}
+
+	// The chunks are written straight out of the vector's array
+	for (size_t start = 0; start < vector->length; start += chunk_size) {
+		size_t count = MIN(chunk_size, vector->length - start);
+		if (!vector_stream_write_chunk(fd, get_elem(vector, start), count, vector->elem_size)) {
+			return FALSE;
+		}
+	}
+
+	return vector_stream_write_chunk(fd, NULL, 0, vector->elem_size);
+}
+
+/**
+ * Reads a stream of chunks from a file descriptor, handing each chunk to a consumer callback.
+ * A background thread reads the next chunk while the consumer works on the current one,
+ * so at most two chunks are ever held in memory.
+ *
+ * @param fd The file descriptor to read from
+ * @param consume The function pointer called with each chunk's elements, element count and element size
+ * @param context Passed through untouched to every call of consume
+ * @return The element size of the stream, or 0 if it was invalid, corrupt or cut short (or the reader thread could not start)
+ */
+size_t vector_stream_consume(int fd, void (*consume)(void *elements, size_t count, size_t elem_size, void *context),
+		void *context) {
+	VectorStreamHeader header;
+	if (!read_fully(fd, &header, sizeof(header))) {
+		fprintf(stderr, "ERROR: Failed to read vector stream header!\n");
+		return 0;
+	}
+	if (memcmp(header.magic, VECTOR_STREAM_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != VECTOR_FILE_VERSION || header.endianness != 0x01020304 || header.elem_size == 0) {
+		fprintf(stderr, "ERROR: Not a compatible vector stream!\n");
+		return 0;
+	}
+
+	StreamReader reader;
+	memset(&reader, 0, sizeof(reader));
+	reader.fd = fd;
+	reader.elem_size = header.elem_size;
+	pthread_mutex_init(&reader.lock, NULL);
+	pthread_cond_init(&reader.changed, NULL);
+
+	pthread_t thread;
+	int error = pthread_create(&thread, NULL, stream_reader_thread, &reader);
+	if (error != 0) {
+		fprintf(stderr, "ERROR: Failed to start vector stream reader: %s\n", strerror(error));
+		pthread_mutex_destroy(&reader.lock);
+		pthread_cond_destroy(&reader.changed);
+		return 0;
+	}
+
+	BOOL ok = TRUE;
+	for (int current = 0; ; current = 1 - current) {
+		pthread_mutex_lock(&reader.lock);
+		while (!reader.full[current] && !reader.failed) {
+			pthread_cond_wait(&reader.changed, &reader.lock);
+		}
+		BOOL failed = !reader.full[current] && reader.failed;
+		pthread_mutex_unlock(&reader.lock);
+
+		if (failed) {
+			ok = FALSE;
+			break;
+		}
+		if (reader.counts[current] == 0) {
+			break;
+		}
+
+		consume(reader.buffers[current], reader.counts[current], reader.elem_size, context);
+
+		pthread_mutex_lock(&reader.lock);
+		reader.full[current] = FALSE;
+		pthread_cond_broadcast(&reader.changed);
+		pthread_mutex_unlock(&reader.lock);
+	}
+
+	pthread_mutex_lock(&reader.lock);
+	reader.stopped = TRUE;
+	pthread_cond_broadcast(&reader.changed);
+	pthread_mutex_unlock(&reader.lock);
+	pthread_join(thread, NULL);
+
+	pthread_mutex_destroy(&reader.lock);
+	pthread_cond_destroy(&reader.changed);
+	free(reader.buffers[0]);
+	free(reader.buffers[1]);
+	return ok ? header.elem_size : 0;
+}
+
+/**
+ * Reads a stream of chunks from a file descriptor into a new vector.
+ *
+ * @param fd The file descriptor to read from
+ * @return The vector, or NULL if the stream was invalid, corrupt or cut short
+ */
+Vector* vector_stream_read(int fd) {
+	Vector *vector = NULL;
+	size_t elem_size = vector_stream_consume(fd, stream_append, &vector);
+
+	if (elem_size == 0) {
+		if (vector != NULL) {
+			free_vector(vector);
+		}
+		return NULL;
+	}
+
+	// An empty stream never created the vector
+	if (vector == NULL) {
+		vector = create_vector(elem_size);
+	}
+	return vector;
+}
+
+
+/**
+ * Rounds a size up to a multiple of VECTOR_DIRECT_ALIGN.
+ *
+ * @param bytes The size
+ * @return The rounded size
+ */
+static size_t direct_align(size_t bytes) {
+	return (bytes + VECTOR_DIRECT_ALIGN - 1) / VECTOR_DIRECT_ALIGN * VECTOR_DIRECT_ALIGN;
+}
+
+/**
+ * Opens a file for vector_save_async / vector_load_async, with O_DIRECT if asked for and supported.
+ *
+ * @param path The path of the file
+ * @param flags The open flags (other than O_DIRECT)
+ * @param direct Whether to try O_DIRECT, cleared if the file system refuses it
+ * @return The file descriptor, or -1 on failure
+ */
+static int open_for_async_io(const char *path, int flags, BOOL *direct) {
+	int fd = open(path, flags | (*direct ? O_DIRECT : 0), 0644);
+
+	if (fd < 0 && *direct && errno == EINVAL) { // tmpfs and friends have no O_DIRECT
+		*direct = FALSE;
+		fd = open(path, flags, 0644);
+	}
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s: %s\n", path, strerror(errno));
+	}
+	return fd;
+}
+
+/**
+ * Creates a VectorIORequest for an opened file (its thread is not yet started).
+ *
+ * @param fd The open file descriptor
+ * @param load Whether it is a load
+ * @param direct Whether the file was opened with O_DIRECT
+ * @param callback The completion callback, or NULL
+ * @param context Passed through untouched to the callback
+ * @return The request, or NULL (with fd closed) if its eventfd could not be created
+ */
+static VectorIORequest* create_vector_io(int fd, BOOL load, BOOL direct,
+		void (*callback)(VectorIORequest *request, BOOL ok, void *context), void *context) {
+	VectorIORequest *request = malloc(sizeof(VectorIORequest));
+	memset(request, 0, sizeof(VectorIORequest));
+
+	request->fd = fd;
+	request->load = load;
+	request->direct = direct;
+	request->event_fd = eventfd(0, EFD_CLOEXEC);
+	request->callback = callback;
+	request->context = context;
+
+	if (request->event_fd < 0) {
+		fprintf(stderr, "ERROR: Failed to start vector I/O: %s\n", strerror(errno));
+		close(fd);
+		free(request);
+		return NULL;
+	}
+
+	pthread_mutex_init(&request->lock, NULL);
+	pthread_cond_init(&request->finished, NULL);
+	return request;
+}
+
+/**
+ * Transfers the vector file header of a request at the start of its file.
+ * Saves write a header describing the vector, loads read and validate one and create the vector.
+ *
+ * @param request The request
+ * @return Whether it succeeded
+ */
+static BOOL vector_io_header(VectorIORequest *request) {
+	char *header_bytes; // Aligned, for O_DIRECT
+	if (posix_memalign((void**) &header_bytes, VECTOR_DIRECT_ALIGN, VECTOR_FILE_HEADER_SIZE) != 0) {
+		fprintf(stderr, "ERROR: Vector I/O buffer allocation failed, possibly out of memory? Exiting...\n");
+		exit(1);
+	}
+
+	BOOL ok;
+	if (!request->load) {
+		vector_file_header(request->vector, header_bytes, TRUE);
+		ok = pwrite(request->fd, header_bytes, VECTOR_FILE_HEADER_SIZE, 0) == VECTOR_FILE_HEADER_SIZE;
+		if (!ok) {
+			fprintf(stderr, "ERROR: Failed to write vector: %s\n", strerror(errno));
+		}
+	} else {
+		VectorFileHeader *header = (VectorFileHeader*) header_bytes;
+		ok = pread(request->fd, header_bytes, VECTOR_FILE_HEADER_SIZE, 0) == VECTOR_FILE_HEADER_SIZE;
+		if (!ok) {
+			fprintf(stderr, "ERROR: Failed to read vector header!\n");
+		}
+		ok = ok && vector_file_header_valid(header)
+				&& vector_file_data_fits(request->fd, header, VECTOR_FILE_HEADER_SIZE, NULL);
+
+		if (ok) {
+			// Sized exactly, and aligned so O_DIRECT can read straight into the array
+			Vector *vector = create_vector_with_capacity(header->elem_size, 0);
+			request->data_bytes = header->length * header->elem_size;
+			free(vector->array);
+			if (posix_memalign(&vector->array, VECTOR_DIRECT_ALIGN,
+					direct_align(MAX(request->data_bytes, header->elem_size))) != 0) {
+				fprintf(stderr, "ERROR: Vector allocation failed, possibly out of memory? Exiting...\n");
+				exit(1);
+			}
+			vector->capacity = MAX(header->length, 1);
+			vector->length = header->length;
+			request->vector = vector;
+			request->checksum = header->checksum;
+		}
+	}
+
+	free(header_bytes);
+	return ok;
+}
+
+/**
+ * Transfers one chunk of a request's array to or from its file.
+ *
+ * @param request The request
+ * @param chunk The index of the chunk
+ * @param bounce A VECTOR_ASYNC_CHUNK byte aligned buffer for O_DIRECT saves, otherwise unused
+ * @return Whether it succeeded
+ */
+static BOOL vector_io_chunk(VectorIORequest *request, size_t chunk, void *bounce) {
+	size_t start = chunk * VECTOR_ASYNC_CHUNK;
+	size_t bytes = MIN(VECTOR_ASYNC_CHUNK, request->data_bytes - start);
+	size_t padded = request->direct ? direct_align(bytes) : bytes;
+	off_t offset = VECTOR_FILE_HEADER_SIZE + start;
+	void *data = request->vector->array + start;
+
+	// O_DIRECT needs aligned memory and whole blocks, which a saved array does not promise
+	if (request->direct && !request->load) {
+		memcpy(bounce, data, bytes);
+		memset(bounce + bytes, 0, padded - bytes);
+		data = bounce;
+	}
+
+	size_t done = 0;
+	while (done < bytes) {
+		ssize_t result = request->load
+				? pread(request->fd, data + done, padded - done, offset + done)
+				: pwrite(request->fd, data + done, padded - done, offset + done);
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+		if (result <= 0) {
+			if (result == 0) {
+				fprintf(stderr, "ERROR: Vector file is truncated!\n");
+			} else {
+				fprintf(stderr, "ERROR: Failed to %s vector: %s\n", request->load ? "read" : "write", strerror(errno));
+			}
+			return FALSE;
+		}
+		done += result;
+	}
+
+	return TRUE;
+}
+
+/**
+ * The body of each thread of a request's pool: transfers chunks until none are left
+ * (or the request has failed).
+ *
+ * @param argument The VectorIORequest
+ * @return NULL
+ */
+static void* vector_io_worker(void *argument) {
+	VectorIORequest *request = argument;
+	size_t chunks = (request->data_bytes + VECTOR_ASYNC_CHUNK - 1) / VECTOR_ASYNC_CHUNK;
+
+	void *bounce = NULL;
+	if (request->direct && !request->load
+			&& posix_memalign(&bounce, VECTOR_DIRECT_ALIGN, VECTOR_ASYNC_CHUNK) != 0) {
+		fprintf(stderr, "ERROR: Vector I/O buffer allocation failed, possibly out of memory? Exiting...\n");
+		exit(1);
+	}
+
+	while (TRUE) {
+		pthread_mutex_lock(&request->lock);
+		size_t chunk = request->next_chunk++;
+		BOOL failed = request->failed;
+		pthread_mutex_unlock(&request->lock);
+
+		if (failed || chunk >= chunks) {
+			break;
+		}
+		if (!vector_io_chunk(request, chunk, bounce)) {
+			pthread_mutex_lock(&request->lock);
+			request->failed = TRUE;
+			pthread_mutex_unlock(&request->lock);
+		}
+	}
+
+	free(bounce);
+	return NULL;
+}
+
+/**
+ * The thread running a request: transfers the header, then the array with a pool of
+ * VECTOR_ASYNC_THREADS threads (itself included), then reports completion.
+ *
+ * @param argument The VectorIORequest
+ * @return NULL
+ */
+static void* vector_io_thread(void *argument) {
+	VectorIORequest *request = argument;
+	BOOL ok = vector_io_header(request);
+
+	if (ok) {
+		pthread_t helpers[VECTOR_ASYNC_THREADS - 1];
+		size_t chunks = (request->data_bytes + VECTOR_ASYNC_CHUNK - 1) / VECTOR_ASYNC_CHUNK;
+		size_t count = MIN(VECTOR_ASYNC_THREADS - 1, chunks > 0 ? chunks - 1 : 0);
+
+		// Helpers only share the chunks out, so if one cannot be created the rest of the work runs on this thread
+		for (size_t i = 0; i < count; i++) {
+			if (pthread_create(&helpers[i], NULL, vector_io_worker, request) != 0) {
+				count = i;
+				break;
+			}
+		}
+		vector_io_worker(request);
+		for (size_t i = 0; i < count; i++) {
+			pthread_join(helpers[i], NULL);
+		}
+		ok = !request->failed;
+	}
+
+	// The last O_DIRECT block was written padded
+	if (ok && request->direct && !request->load
+			&& ftruncate(request->fd, VECTOR_FILE_HEADER_SIZE + request->data_bytes) != 0) {
+		fprintf(stderr, "ERROR: Failed to write vector: %s\n", strerror(errno));
+		ok = FALSE;
+	}
+	if (close(request->fd) != 0 && !request->load) {
+		fprintf(stderr, "ERROR: Failed to close vector file: %s\n", strerror(errno));
+		ok = FALSE;
+	}
+
+	if (ok && request->load && request->checksum != 0
+			&& hash_bytes(request->vector->array, request->data_bytes) != request->checksum) {
+		fprintf(stderr, "ERROR: Vector file checksum mismatch, the file is corrupt!\n");
+		ok = FALSE;
+	}
+	if (!ok && request->load && request->vector != NULL) {
+		free_vector(request->vector);
+		request->vector = NULL;
+	}
+
+	pthread_mutex_lock(&request->lock);
+	request->failed = !ok;
+	pthread_mutex_unlock(&request->lock);
+
+	if (request->callback != NULL) {
+		request->callback(request, ok, request->context);
+	}
+
+	pthread_mutex_lock(&request->lock);
+	request->done = TRUE;
+	pthread_cond_broadcast(&request->finished);
+	pthread_mutex_unlock(&request->lock);
+
+	uint64_t one = 1;
+	if (write(request->event_fd, &one, sizeof(one)) != sizeof(one)) {
+		fprintf(stderr, "ERROR: Failed to signal vector I/O completion: %s\n", strerror(errno));
+	}
+	return NULL;
+}
+
+/**
+ * Starts the thread of a request from create_vector_io, or releases the request if it cannot be started.
+ *
+ * @param request The request
+ * @return The request, or NULL (with its file closed and the request freed) if the thread could not be created
+ */
+static VectorIORequest* start_vector_io(VectorIORequest *request) {
+	int error = pthread_create(&request->thread, NULL, vector_io_thread, request);
+	if (error == 0) {
+		return request;
+	}
+
+	fprintf(stderr, "ERROR: Failed to start vector I/O: %s\n", strerror(error));
+	close(request->fd);
+	close(request->event_fd);
+	pthread_mutex_destroy(&request->lock);
+	pthread_cond_destroy(&request->finished);
+	free(request);
+	return NULL;
+}
+
+/**
+ * Starts saving a vector to a file (in the format of vector_save) in the background.
+ * The vector must not be modified or freed until the request has finished.
+ *
+ * @param vector The vector to save
+ * @param path The path of the file, which is replaced
+ * @param direct Whether to bypass the page cache with O_DIRECT (ignored where the file system lacks it)
+ * @param callback The function pointer called on the I/O thread once the save finishes, or NULL
+ * @param context Passed through untouched to the callback
+ * @return The request, or NULL if the file could not be opened or the I/O thread could not be started
+ */
+VectorIORequest* vector_save_async(Vector *vector, const char *path, BOOL direct,
+		void (*callback)(VectorIORequest *request, BOOL ok, void *context), void *context) {
+	int fd = open_for_async_io(path, O_WRONLY | O_CREAT | O_TRUNC, &direct);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	VectorIORequest *request = create_vector_io(fd, FALSE, direct, callback, context);
+	if (request == NULL) {
+		return NULL;
+	}
+	request->vector = vector;
+	request->data_bytes = vector->length * vector->elem_size;
+	return start_vector_io(request);
+}
+
+/**
+ * Starts loading a vector saved by vector_save (or vector_save_async) in the background.
+ * Collect the vector with vector_io_take.
+ *
+ * @param path The path of the file
+ * @param direct Whether to bypass the page cache with O_DIRECT (ignored where the file system lacks it)
+ * @param callback The function pointer called on the I/O thread once the load finishes, or NULL
+ * @param context Passed through untouched to the callback
+ * @return The request, or NULL if the file could not be opened or the I/O thread could not be started
+ */
+VectorIORequest* vector_load_async(const char *path, BOOL direct,
+		void (*callback)(VectorIORequest *request, BOOL ok, void *context), void *context) {
+	int fd = open_for_async_io(path, O_RDONLY, &direct);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	VectorIORequest *request = create_vector_io(fd, TRUE, direct, callback, context);
+	if (request == NULL) {
+		return NULL;
+	}
+	return start_vector_io(request);
+}
+
+/**
+ * A file descriptor which polls readable (with poll, select or epoll) once a request has finished.
+ * It stays readable, so it can be watched by any number of event loops.
+ *
+ * @param request The request
+ * @return The file descriptor, owned by the request
+ */
+int vector_io_fd(VectorIORequest *request) {
+	return request->event_fd;
+}
+
+/**
+ * Whether a request has finished, without blocking.
+ *
+ * @param request The request
+ * @return Whether it has finished
+ */
+BOOL vector_io_done(VectorIORequest *request) {
+	pthread_mutex_lock(&request->lock);
+	BOOL done = request->done;
+	pthread_mutex_unlock(&request->lock);
+	return done;
+}
+
+/**
+ * Blocks until a request has finished.
+ *
+ * @param request The request
+ * @return Whether it succeeded
+ */
+BOOL vector_io_wait(VectorIORequest *request) {
+	pthread_mutex_lock(&request->lock);
+	while (!request->done) {
+		pthread_cond_wait(&request->finished, &request->lock);
+	}
+	BOOL ok = !request->failed;
+	pthread_mutex_unlock(&request->lock);
+	return ok;
+}
+
+/**
+ * Blocks until a load has finished and takes the loaded vector, which the caller then owns.
+ *
+ * @param request The load request
+ * @return The loaded vector, or NULL if the load failed (or the vector was already taken)
+ */
+Vector* vector_io_take(VectorIORequest *request) {
+	if (!request->load) {
+		fprintf(stderr, "ERROR: vector_io_take called on a save request!\n");
+		return NULL;
+	}
+	if (!vector_io_wait(request)) {
+		return NULL;
+	}
+
+	Vector *vector = request->vector;
+	request->vector = NULL;
+	return vector;
+}
+
+/**
+ * Waits for a request to finish and frees it (along with a loaded vector which was never taken).
+ * Must not be called from the request's own callback.
+ *
+ * @param request The request
+ */
+void free_vector_io(VectorIORequest *request) {
+	pthread_join(request->thread, NULL);
+
+	if (request->load && request->vector != NULL) {
+		free_vector(request->vector);
+	}
+	close(request->event_fd);
+	pthread_mutex_destroy(&request->lock);
+	pthread_cond_destroy(&request->finished);
+	free(request);
+}
+
+/**
+ * Creates a new vector in a POSIX shared memory segment. Other processes open it with
+ * open_shared_vector (or open_shared_vector_fd) and use it in place instead of each loading a copy.
+ * The whole capacity is reserved up front, so no process ever has to remap the segment;
+ * memory is only used as pages are touched.
+ * Attached indexes (range index, zone map, bloom filter) are private to each process and are not
+ * kept up to date across processes.
+ *
+ * @param name The shm_open name of the segment (eg. "/prices"), or NULL for an anonymous memfd
+ *             to be shared through fork or over a Unix socket (see shared_vector_fd)
+ * @param elem_size The size of each element in the vector
+ * @param reserved The most elements the vector may ever hold
+ * @param locked Whether to put a process shared reader / writer lock in the segment (see lock_shared_vector)
+ * @return The generated vector, or NULL if the segment could not be created (or the name is taken)
+ */
+Vector* create_shared_vector(const char *name, size_t elem_size, size_t reserved, BOOL locked) {
+	int fd = name != NULL
+			? shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)
+			: memfd_create("vector", MFD_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to create shared memory %s: %s\n", name != NULL ? name : "", strerror(errno));
+		return NULL;
+	}
+
+	Vector *empty = create_vector_with_capacity(elem_size, 0);
+	char header_bytes[VECTOR_FILE_HEADER_SIZE];
+	vector_file_header(empty, header_bytes, FALSE);
+	free_vector(empty);
+	((VectorFileHeader*) header_bytes)->capacity = MAX(reserved, 1);
+
+	if (!write_fully(fd, header_bytes, VECTOR_FILE_HEADER_SIZE)
+			|| ftruncate(fd, VECTOR_FILE_HEADER_SIZE + MAX(reserved, 1) * elem_size) != 0) {
+		fprintf(stderr, "ERROR: Failed to size shared memory: %s\n", strerror(errno));
+		close(fd);
+		if (name != NULL) {
+			shm_unlink(name);
+		}
+		return NULL;
+	}
+
+	Vector *vector = map_vector_fd(fd, FALSE);
+	if (vector == NULL) {
+		if (name != NULL) {
+			shm_unlink(name);
+		}
+		return NULL;
+	}
+	vector->mapping->shared = TRUE;
+
+	if (locked) {
+		SharedVectorHeader *header = vector->mapping->base;
+		pthread_rwlockattr_t attributes;
+		pthread_rwlockattr_init(&attributes);
+		pthread_rwlockattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+		pthread_rwlock_init(&header->lock, &attributes);
+		pthread_rwlockattr_destroy(&attributes);
+		header->locked = TRUE;
+	}
+
+	// Published last: openers wait for it before trusting anything else in the segment
+	__atomic_store_n(&((SharedVectorHeader*) vector->mapping->base)->ready, TRUE, __ATOMIC_RELEASE);
+	return vector;
+}
+
+/**
+ * Waits for a shared memory vector's creator to finish initialising its segment
+ * (a named segment can be opened as soon as it exists, before it is sized or its lock is set up).
+ *
+ * @param fd The file descriptor of the segment
+ * @return Whether it became ready within SHARED_VECTOR_OPEN_WAIT milliseconds
+ */
+static BOOL wait_shared_vector_ready(int fd) {
+	struct timespec pause = { 0, 1000000 };
+
+	for (int waited = 0; waited <= SHARED_VECTOR_OPEN_WAIT; waited++) {
+		struct stat status;
+		if (fstat(fd, &status) != 0) {
+			break;
+		}
+		if (status.st_size >= VECTOR_FILE_HEADER_SIZE) {
+			SharedVectorHeader *header = mmap(NULL, VECTOR_FILE_HEADER_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+			if (header == MAP_FAILED) {
+				break;
+			}
+			BOOL ready = __atomic_load_n(&header->ready, __ATOMIC_ACQUIRE);
+			munmap(header, VECTOR_FILE_HEADER_SIZE);
+			if (ready) {
+				return TRUE;
+			}
+		}
+		nanosleep(&pause, NULL);
+	}
+
+	fprintf(stderr, "ERROR: Shared memory vector was never initialised!\n");
+	return FALSE;
+}
+
+/**
+ * Opens a shared memory vector created (by any process) with create_shared_vector,
+ * waiting briefly if it is still being created.
+ *
+ * @param name The shm_open name of the segment
+ * @param read_only Whether to open it read only (the lock can still be taken)
+ * @return The vector, or NULL if the segment does not exist, is invalid or was never finished being created
+ */
+Vector* open_shared_vector(const char *name, BOOL read_only) {
+	// Read write even when read only, since taking the lock writes to the header page
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open shared memory %s: %s\n", name, strerror(errno));
+		return NULL;
+	}
+
+	return open_shared_vector_fd(fd, read_only);
+}
+
+/**
+ * Opens a shared memory vector from a file descriptor of its segment (eg. a memfd received
+ * over a Unix socket), taking ownership of the file descriptor.
+ *
+ * @param fd The file descriptor, open for reading and writing
+ * @param read_only Whether to open it read only (the lock can still be taken)
+ * @return The vector, or NULL if the segment is invalid (fd is closed)
+ */
+Vector* open_shared_vector_fd(int fd, BOOL read_only) {
+	if (!wait_shared_vector_ready(fd)) {
+		close(fd);
+		return NULL;
+	}
+
+	Vector *vector = map_vector_fd(fd, read_only);
+	if (vector == NULL) {
+		return NULL;
+	}
+	vector->mapping->shared = TRUE;
+
+	if (read_only && mprotect(vector->mapping->base, VECTOR_FILE_HEADER_SIZE, PROT_READ | PROT_WRITE) != 0) {
+		fprintf(stderr, "ERROR: Failed to open shared memory lock: %s\n", strerror(errno));
+		free_vector(vector);
+		return NULL;
+	}
+
+	return vector;
+}
+
+/**
+ * The file descriptor of a shared memory vector's segment, to pass to another process
+ * (which opens it with open_shared_vector_fd).
+ *
+ * @param vector The shared memory vector
+ * @return The file descriptor, owned by the vector, or -1 if it is not a shared memory vector
+ */
+int shared_vector_fd(Vector *vector) {
+	if (vector->mapping == NULL || !vector->mapping->shared) {
+		fprintf(stderr, "ERROR: Not a shared memory vector!\n");
+		return -1;
+	}
+	return vector->mapping->fd;
+}
+
+/**
+ * Removes the name of a shared memory vector. Processes which have it open keep using it,
+ * and the memory is released once the last of them frees it.
+ *
+ * @param name The shm_open name of the segment
+ * @return Whether the name was removed
+ */
+BOOL unlink_shared_vector(const char *name) {
+	if (shm_unlink(name) != 0) {
+		fprintf(stderr, "ERROR: Failed to unlink shared memory %s: %s\n", name, strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Locks a shared memory vector (if it was created with a lock) and brings this process's view of it
+ * up to date with changes made by other processes. Call this before every use of the vector,
+ * and unlock_shared_vector after.
+ *
+ * @param vector The shared memory vector
+ * @param exclusive Whether to lock it for writing (otherwise for reading, alongside other readers)
+ */
+void lock_shared_vector(Vector *vector, BOOL exclusive) {
+	if (vector->mapping == NULL || !vector->mapping->shared) {
+		fprintf(stderr, "ERROR: Not a shared memory vector!\n");
+		return;
+	}
+
+	SharedVectorHeader *header = vector->mapping->base;
+	if (header->locked) {
+		if (exclusive) {
+			pthread_rwlock_wrlock(&header->lock);
+		} else {
+			pthread_rwlock_rdlock(&header->lock);
+		}
+	}
+
+	vector->length = header->file.length;
+}
+
+/**
+ * Unlocks a shared memory vector locked with lock_shared_vector.
+ *
+ * @param vector The shared memory vector
+ */
+void unlock_shared_vector(Vector *vector) {
+	if (vector->mapping == NULL || !vector->mapping->shared) {
+		fprintf(stderr, "ERROR: Not a shared memory vector!\n");
+		return;
+	}
+
+	SharedVectorHeader *header = vector->mapping->base;
+	if (header->locked) {
+		pthread_rwlock_unlock(&header->lock);
+	}
+}
+
+/**
+ * Collects the exit status of a background save's child, if it has exited.
+ *
+ * @param save The background save (not yet done)
+ * @param options The waitpid options (WNOHANG to not block)
+ */
+static void reap_background_save(BackgroundSave *save, int options) {
+	int status;
+	pid_t result = waitpid(save->pid, &status, options);
+
+	if (result == save->pid) {
+		save->done = TRUE;
+		save->ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	} else if (result < 0 && errno != EINTR) {
+		fprintf(stderr, "ERROR: Lost track of background save: %s\n", strerror(errno));
+		save->done = TRUE;
+	}
+}
+
+/**
+ * The directory holding a file.
+ *
+ * @param path The path of the file
+ * @return The path of its directory (to free)
+ */
+static char* parent_directory(const char *path) {
+	const char *slash = strrchr(path, '/');
+	return slash == NULL ? strdup(".") : strndup(path, MAX(slash - path, 1));
+}
+
+/**
+ * Flushes a directory to disk, making renames into it durable. Does not allocate.
+ *
+ * @param directory The path of the directory
+ * @return Whether the directory was flushed
+ */
+static BOOL fsync_directory(const char *directory) {
+	int fd = open(directory, O_RDONLY | O_DIRECTORY);
+	if (fd < 0) {
+		return FALSE;
+	}
+
+	BOOL synced = fsync(fd) == 0;
+	close(fd);
+	return synced;
+}
+
+/**
+ * Flushes the directory holding a file to disk, making a rename of the file durable.
+ *
+ * @param path The path of the file
+ * @return Whether the directory was flushed
+ */
+static BOOL fsync_parent_directory(const char *path) {
+	char *directory = parent_directory(path);
+	BOOL synced = fsync_directory(directory);
+	free(directory);
+	return synced;
+}
+
+/**
+ * Snapshots vectors to a file in the background, in the style of Redis' BGSAVE: the process forks,
+ * and the child writes the vectors as they were at the moment of the fork (from its copy on write
+ * view of memory) while the parent carries on modifying them. The parent only pauses for the fork.
+ * The snapshot is written to a temporary file and renamed into place (and the directory flushed),
+ * so path always holds a complete snapshot. Memory mapped vectors are not copied on write, so they are not point in time.
+ *
+ * @param vectors The vectors to save
+ * @param count The amount of vectors
+ * @param path The path of the snapshot file (the vectors one after another, see vector_load_snapshot)
+ * @return The save in progress, or NULL if the process could not fork
+ */
+BackgroundSave* vector_save_background(Vector **vectors, size_t count, const char *path) {
+	// Prepared before the fork, so the child never allocates
+	size_t path_length = strlen(path);
+	char *temporary = malloc(path_length + sizeof(".tmp"));
+	memcpy(temporary, path, path_length);
+	memcpy(temporary + path_length, ".tmp", sizeof(".tmp"));
+	char *directory = parent_directory(path);
+
+	int status[2];
+	if (pipe2(status, O_CLOEXEC) != 0) {
+		fprintf(stderr, "ERROR: Failed to start background save: %s\n", strerror(errno));
+		free(temporary);
+		free(directory);
+		return NULL;
+	}
+
+	fflush(NULL); // Or buffered output is written twice
+	pid_t pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "ERROR: Failed to start background save: %s\n", strerror(errno));
+		close(status[0]);
+		close(status[1]);
+		free(temporary);
+		free(directory);
+		return NULL;
+	}
+
+	if (pid == 0) {
+		close(status[0]);
+
+		BOOL saved = FALSE;
+		int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd >= 0) {
+			saved = TRUE;
+			for (size_t i = 0; i < count && saved; i++) {
+				saved = vector_write_fd(vectors[i], fd);
+			}
+			saved = saved && fsync(fd) == 0;
+			saved = close(fd) == 0 && saved;
+			saved = saved && rename(temporary, path) == 0;
+			saved = saved && fsync_directory(directory);
+		}
+		if (!saved) {
+			fprintf(stderr, "ERROR: Background save to %s failed: %s\n", path, strerror(errno));
+			unlink(temporary);
+		}
+		_exit(saved ? 0 : 1); // status[1] closes as the child exits
+	}
+
+	close(status[1]);
+	free(temporary);
+	free(directory);
+
+	BackgroundSave *save = malloc(sizeof(BackgroundSave));
+	save->pid = pid;
+	save->status_fd = status[0];
+	save->done = FALSE;
+	save->ok = FALSE;
+	return save;
+}
+
+/**
+ * A file descriptor which polls readable (with poll, select or epoll) once a background save's
+ * child has exited. Call background_save_done then to collect the result.
+ *
+ * @param save The background save
+ * @return The file descriptor, owned by the save
+ */
+int background_save_fd(BackgroundSave *save) {
+	return save->status_fd;
+}
+
+/**
+ * Whether a background save has finished, without blocking.
+ *
+ * @param save The background save
+ * @return Whether it has finished (see background_save_wait for whether it succeeded)
+ */
+BOOL background_save_done(BackgroundSave *save) {
+	if (!save->done) {
+		reap_background_save(save, WNOHANG);
+	}
+	return save->done;
+}
+
+/**
+ * Blocks until a background save has finished.
+ *
+ * @param save The background save
+ * @return Whether the snapshot was written
+ */
+BOOL background_save_wait(BackgroundSave *save) {
+	while (!save->done) {
+		reap_background_save(save, 0);
+	}
+	return save->ok;
+}
+
+/**
+ * Waits for a background save to finish and frees it.
+ *
+ * @param save The background save
+ */
+void free_background_save(BackgroundSave *save) {
+	background_save_wait(save);
+	close(save->status_fd);
+	free(save);
+}
+
+/**
+ * Loads the vectors of a snapshot written by vector_save_background.
+ *
+ * @param path The path of the snapshot file
+ * @param vectors Where to store the loaded vectors
+ * @param count The amount of vectors in the snapshot
+ * @return Whether all of them were loaded (if not, none are kept)
+ */
+BOOL vector_load_snapshot(const char *path, Vector **vectors, size_t count) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s for reading: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		vectors[i] = vector_read_fd(fd);
+
+		if (vectors[i] == NULL) {
+			for (size_t j = 0; j < i; j++) {
+				free_vector(vectors[j]);
+				vectors[j] = NULL;
+			}
+			close(fd);
+			return FALSE;
+		}
+	}
+
+	close(fd);
+	return TRUE;
+}
+
+/**
+ * Whether a block of a vector with dirty tracking is dirty (and still within its length).
+ *
+ * @param vector The vector with dirty tracking
+ * @param block The index of the block
+ * @return Whether it is dirty
+ */
+static BOOL is_dirty_block(Vector *vector, size_t block) {
+	DirtyMap *dirty = vector->dirty;
+	return block < dirty->block_count && block * dirty->block_elems < vector->length
+			&& (dirty->bits[block / 64] >> (block % 64)) & 1;
+}
+
+/**
+ * The amount of elements in a block of a vector with dirty tracking (only the last block is short).
+ *
+ * @param vector The vector with dirty tracking
+ * @param block The index of the block (within the vector's length)
+ * @return The amount of elements
+ */
+static size_t dirty_block_elems(Vector *vector, size_t block) {
+	size_t start = block * vector->dirty->block_elems;
+	return MIN(vector->dirty->block_elems, vector->length - start);
+}
+
+/**
+ * Reads through a delta file, verifying it and (if base_fd is given) writing its blocks to a base file.
+ *
+ * @param base_fd The file descriptor of the base file, or -1 to only verify the delta
+ * @param path The path of the delta file
+ * @param elem_size The element size of the base file
+ * @param length The length of the vector so far, updated to the delta's
+ * @return Whether the delta is valid (and was applied)
+ */
+static BOOL apply_vector_delta(int base_fd, const char *path, size_t elem_size, size_t *length) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s for reading: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+
+	VectorDeltaHeader header;
+	if (!read_fully(fd, &header, sizeof(header))) {
+		fprintf(stderr, "ERROR: Failed to read vector delta header!\n");
+		close(fd);
+		return FALSE;
+	}
+	if (memcmp(header.magic, VECTOR_DELTA_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != VECTOR_FILE_VERSION || header.endianness != 0x01020304
+			|| header.elem_size != elem_size || header.block_elems == 0) {
+		fprintf(stderr, "ERROR: %s is not a compatible vector delta!\n", path);
+		close(fd);
+		return FALSE;
+	}
+
+	size_t block_bytes = header.block_elems * elem_size;
+	void *buffer = malloc(block_bytes);
+	BOOL ok = TRUE;
+
+	for (size_t i = 0; i < header.block_count && ok; i++) {
+		DeltaBlockHeader block;
+		ok = read_fully(fd, &block, sizeof(block)) && block.block * header.block_elems < header.length;
+
+		size_t bytes = 0;
+		if (ok) {
+			bytes = MIN(header.block_elems, header.length - block.block * header.block_elems) * elem_size;
+			ok = read_fully(fd, buffer, bytes) && hash_bytes(buffer, bytes) == block.checksum;
+		}
+		if (!ok) {
+			fprintf(stderr, "ERROR: Vector delta %s is corrupt or truncated!\n", path);
+		} else if (base_fd >= 0) {
+			off_t offset = VECTOR_FILE_HEADER_SIZE + block.block * block_bytes;
+			ok = pwrite(base_fd, buffer, bytes, offset) == (ssize_t) bytes;
+			if (!ok) {
+				fprintf(stderr, "ERROR: Failed to apply vector delta: %s\n", strerror(errno));
+			}
+		}
+	}
+
+	free(buffer);
+	close(fd);
+	if (ok) {
+		*length = header.length;
+	}
+	return ok;
+}
+
+/**
+ * Starts tracking which blocks of a vector change (through push_back, set_elem, remove_elem,
+ * swap_elems, sort_vector and everything else which calls vector_modified), so vector_save_delta
+ * can write only those. Every block starts clean: attach it right after saving the base file.
+ * Replaces any dirty tracking already attached.
+ *
+ * @param vector The vector
+ */
+void attach_dirty_map(Vector *vector) {
+	detach_dirty_map(vector);
+
+	DirtyMap *dirty = malloc(sizeof(DirtyMap));
+	dirty->bits = NULL;
+	dirty->block_count = 0;
+	dirty->block_elems = MAX(DIRTY_BLOCK_SIZE / vector->elem_size, 1);
+	vector->dirty = dirty;
+}
+
+/**
+ * Detaches (and deallocates) the dirty tracking of a vector, if it has one.
+ *
+ * @param vector The vector
+ */
+void detach_dirty_map(Vector *vector) {
+	if (vector->dirty == NULL) {
+		return;
+	}
+
+	free(vector->dirty->bits);
+	free(vector->dirty);
+	vector->dirty = NULL;
+}
+
+/**
+ * Marks the blocks holding [from, to) of a vector dirty. Called by vector_modified.
+ *
+ * @param vector The vector with dirty tracking
+ * @param from The first changed index
+ * @param to One past the last changed index
+ */
+void dirty_map_update(Vector *vector, size_t from, size_t to) {
+	DirtyMap *dirty = vector->dirty;
+	if (from >= to) {
+		return;
+	}
+
+	size_t first = from / dirty->block_elems;
+	size_t last = (to - 1) / dirty->block_elems;
+
+	if (last >= dirty->block_count) {
+		size_t new_count = MAX(dirty->block_count * 2, (last + 64) / 64 * 64);
+		unsigned long long *bits = realloc(dirty->bits, new_count / 64 * sizeof(unsigned long long));
+		if (bits == NULL) { // PANIC!
+			fprintf(stderr, "ERROR: Dirty map expansion failed, possibly out of memory? Exiting...\n");
+			exit(1);
+		}
+		memset(bits + dirty->block_count / 64, 0, (new_count - dirty->block_count) / 64 * sizeof(unsigned long long));
+		dirty->bits = bits;
+		dirty->block_count = new_count;
+	}
+
+	for (size_t block = first; block <= last; block++) {
+		dirty->bits[block / 64] |= 1ULL << (block % 64);
+	}
+}
+
+/**
+ * The amount of blocks of a vector changed since dirty tracking was attached or the last delta was saved.
+ *
+ * @param vector The vector with dirty tracking
+ * @return The amount of dirty blocks (within the current length)
+ */
+size_t dirty_block_count(Vector *vector) {
+	if (vector->dirty == NULL) {
+		fprintf(stderr, "ERROR: Vector has no dirty tracking attached!\n");
+		return 0;
+	}
+
+	size_t count = 0;
+	for (size_t block = 0; block < vector->dirty->block_count; block++) {
+		if (is_dirty_block(vector, block)) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Saves only the blocks of a vector changed since dirty tracking was attached or the last delta was
+ * saved, as a delta file, and marks every block clean again. Applying the deltas in the order they
+ * were saved to the base file (see compact_vector_deltas) gives the vector as it is now.
+ *
+ * @param vector The vector with dirty tracking
+ * @param path The path of the delta file, which is replaced
+ * @return Whether the delta was saved (if not, the blocks stay dirty)
+ */
+BOOL vector_save_delta(Vector *vector, const char *path) {
+	DirtyMap *dirty = vector->dirty;
+	if (dirty == NULL) {
+		fprintf(stderr, "ERROR: Vector has no dirty tracking attached!\n");
+		return FALSE;
+	}
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s for writing: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+
+	VectorDeltaHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, VECTOR_DELTA_MAGIC, sizeof(header.magic));
+	header.version = VECTOR_FILE_VERSION;
+	header.endianness = 0x01020304;
+	header.elem_size = vector->elem_size;
+	header.length = vector->length;
+	header.block_elems = dirty->block_elems;
+	header.block_count = dirty_block_count(vector);
+
+	BOOL saved = write_fully(fd, &header, sizeof(header));
+	for (size_t block = 0; block < dirty->block_count && saved; block++) {
+		if (!is_dirty_block(vector, block)) {
+			continue;
+		}
+
+		void *elements = get_elem(vector, block * dirty->block_elems);
+		size_t bytes = dirty_block_elems(vector, block) * vector->elem_size;
+		DeltaBlockHeader block_header = { block, hash_bytes(elements, bytes) };
+
+		saved = write_fully(fd, &block_header, sizeof(block_header)) && write_fully(fd, elements, bytes);
+	}
+	if (!saved) {
+		fprintf(stderr, "ERROR: Failed to write vector delta: %s\n", strerror(errno));
+	}
+	if (close(fd) != 0) {
+		fprintf(stderr, "ERROR: Failed to close %s: %s\n", path, strerror(errno));
+		saved = FALSE;
+	}
+
+	if (saved) {
+		memset(dirty->bits, 0, dirty->block_count / 64 * sizeof(unsigned long long));
+	}
+	return saved;
+}
+
+/**
+ * Folds delta files (from vector_save_delta) into the base file they were saved against
+ * (from vector_save), in place, so the base holds the vector as of the last delta. Every delta is
+ * verified before the base is touched. The deltas can be deleted afterwards.
+ * The base file's checksum is cleared, since recomputing it would read the whole file.
+ *
+ * @param base_path The path of the base file
+ * @param delta_paths The paths of the delta files, in the order they were saved
+ * @param count The amount of delta files
+ * @return Whether the deltas were folded in
+ */
+BOOL compact_vector_deltas(const char *base_path, const char **delta_paths, size_t count) {
+	int fd = open(base_path, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s: %s\n", base_path, strerror(errno));
+		return FALSE;
+	}
+
+	VectorFileHeader header;
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		fprintf(stderr, "ERROR: Failed to read vector header!\n");
+		close(fd);
+		return FALSE;
+	}
+	if (!vector_file_header_valid(&header)) {
+		close(fd);
+		return FALSE;
+	}
+
+	size_t length = header.length;
+	BOOL ok = TRUE;
+	for (size_t i = 0; i < count && ok; i++) {
+		ok = apply_vector_delta(-1, delta_paths[i], header.elem_size, &length);
+	}
+	for (size_t i = 0; i < count && ok; i++) {
+		ok = apply_vector_delta(fd, delta_paths[i], header.elem_size, &length);
+	}
+
+	if (ok) {
+		header.length = length;
+		header.capacity = length;
+		header.checksum = 0;
+		ok = ftruncate(fd, VECTOR_FILE_HEADER_SIZE + length * header.elem_size) == 0
+				&& pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+		if (!ok) {
+			fprintf(stderr, "ERROR: Failed to write %s: %s\n", base_path, strerror(errno));
+		}
+	}
+	if (close(fd) != 0) {
+		fprintf(stderr, "ERROR: Failed to close %s: %s\n", base_path, strerror(errno));
+		ok = FALSE;
+	}
+	return ok;
+}
+
+/**
+ * The amount of elements following a journal record.
+ *
+ * @param record The record
+ * @return The amount of elements
+ */
+static size_t journal_record_elems(JournalRecord *record) {
+	switch (record->op) {
+		case JOURNAL_PUSH_BACK:
+		case JOURNAL_SET_ELEM:
+			return 1;
+		case JOURNAL_SET_RANGE:
+			return record->second;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * The checksum of a journal record and its elements.
+ *
+ * @param record The record (its checksum field is ignored)
+ * @param elements The elements following it
+ * @param bytes The size of the elements
+ * @return The checksum
+ */
+static unsigned long long journal_checksum(JournalRecord *record, void *elements, size_t bytes) {
+	JournalRecord unsummed = *record;
+	unsummed.checksum = 0;
+	return hash_bytes(&unsummed, sizeof(unsummed)) * 31 + hash_bytes(elements, bytes);
+}
+
+/**
+ * Applies a journal record to a vector, unless it is out of bounds.
+ *
+ * @param vector The vector
+ * @param record The record
+ * @param elements The elements following the record
+ * @return Whether it was applied
+ */
+static BOOL journal_apply(Vector *vector, JournalRecord *record, void *elements) {
+	size_t first = record->first;
+	size_t second = record->second;
+
+	switch (record->op) {
+		case JOURNAL_PUSH_BACK:
+			push_back(vector, elements);
+			return TRUE;
+		case JOURNAL_SET_ELEM:
+			if (first >= vector->length) {
+				return FALSE;
+			}
+			set_elem(vector, first, elements);
+			return TRUE;
+		case JOURNAL_REMOVE_ELEM:
+			if (first >= vector->length) {
+				return FALSE;
+			}
+			remove_elem(vector, first);
+			return TRUE;
+		case JOURNAL_SWAP_ELEMS:
+			if (first >= vector->length || second >= vector->length) {
+				return FALSE;
+			}
+			swap_elems(vector, first, second);
+			return TRUE;
+		case JOURNAL_SET_RANGE:
+			if (first > vector->length || second > vector->length - first) {
+				return FALSE;
+			}
+			memcpy(get_elem(vector, first), elements, second * vector->elem_size);
+			vector_modified(vector, first, first + second);
+			return TRUE;
+		case JOURNAL_REMOVE_RANGE: {
+			if (first > second || second > vector->length) {
+				return FALSE;
+			}
+			size_t old_length = vector->length;
+			memmove(get_elem(vector, first), get_elem(vector, second), (vector->length - second) * vector->elem_size);
+			vector->length -= second - first;
+			vector_modified(vector, first, old_length);
+			return TRUE;
+		}
+		default:
+			return FALSE;
 	}
-	vector->length--;
 }
 
 /**
- * Searches a vector and returns the index of where a given element lies.
+ * Applies an operation to a journaled vector and adds its record to the pending group,
+ * committing the group once it is full.
  *
- * @param vector The vector to search
- * @param element The data to search for
- * @return The index of the found element, or -1 if it does not exist
+ * @param journaled The journaled vector
+ * @param op The JournalOp
+ * @param first The first index of the record
+ * @param second The second index (or count) of the record
+ * @param elements The elements of the record
+ * @return Whether it was applied (and committed, if a commit was due)
  */
-int index_of(Vector *vector, void *element) {
-	for (int i = 0; i < vector->length; i++) {
-		void *candidate = get_elem(vector, i);
-		if (memcmp(candidate, element, vector->elem_size) == 0) { // memcmp returns 0 if memory is equal
-			return i;
-		}
+static BOOL journal_record(JournaledVector *journaled, JournalOp op, size_t first, size_t second, void *elements) {
+	if (!check_writable(journaled->vector, "journal_record")) {
+		return FALSE;
 	}
 
-	return -1;
+	JournalRecord record = { op, first, second, 0 };
+	size_t bytes = journal_record_elems(&record) * journaled->vector->elem_size;
+	record.checksum = journal_checksum(&record, elements, bytes);
+
+	if (!journal_apply(journaled->vector, &record, elements)) {
+		fprintf(stderr, "ERROR: Journaled vector operation out of bounds!\n");
+		return FALSE;
+	}
+
+	Vector *pending = journaled->pending;
+	reserve_vector(pending, pending->length + sizeof(record) + bytes);
+	memcpy(pending->array + pending->length, &record, sizeof(record));
+	if (bytes > 0) {
+		memcpy(pending->array + pending->length + sizeof(record), elements, bytes);
+	}
+	pending->length += sizeof(record) + bytes;
+	journaled->pending_records++;
+
+	if (journaled->commit_every > 0 && journaled->pending_records >= journaled->commit_every) {
+		return journal_commit(journaled);
+	}
+	return TRUE;
 }
 
 /**
- * Whether the vector is currently empty.
+ * Empties a journaled vector's log, leaving just a header naming the vector as it is now as the base.
  *
- * @param vector The vector
- * @return Whether it is empty
+ * @param journaled The journaled vector
+ * @return Whether the log was reset
  */
-BOOL is_empty(Vector *vector) {
-	return vector->length == 0;
+static BOOL journal_reset_log(JournaledVector *journaled) {
+	Vector *vector = journaled->vector;
+
+	JournalHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, VECTOR_JOURNAL_MAGIC, sizeof(header.magic));
+	header.version = VECTOR_FILE_VERSION;
+	header.endianness = 0x01020304;
+	header.elem_size = vector->elem_size;
+	header.base_length = vector->length;
+	header.base_checksum = hash_bytes(vector->array, vector->length * vector->elem_size);
+
+	if (ftruncate(journaled->log_fd, 0) != 0 || lseek(journaled->log_fd, 0, SEEK_SET) != 0
+			|| !write_fully(journaled->log_fd, &header, sizeof(header))
+			|| fdatasync(journaled->log_fd) != 0) {
+		fprintf(stderr, "ERROR: Failed to reset %s: %s\n", journaled->log_path, strerror(errno));
+		return FALSE;
+	}
+
+	journaled->log_bytes = sizeof(header);
+	return TRUE;
 }
 
 /**
- * Whether any elements are common between two vectors.
+ * Replays a journaled vector's log onto its freshly loaded base, truncating any torn tail.
+ * A missing or empty log, or one written against a different base (left over from a checkpoint
+ * interrupted after the new base was renamed into place), is reset instead.
  *
- * @param vector1 The first vector
- * @param vector2 The second vector
- * @return Whether any elements are the same
+ * @param journaled The journaled vector
+ * @return Whether the log was usable
  */
-BOOL any_elems_shared(Vector *vector1, Vector *vector2) {
-	if (vector1->elem_size != vector2->elem_size) {
-		fprintf(stderr, "ERROR: Attempted to compare vectors with inequal element sizes!\n");
+static BOOL journal_replay(JournaledVector *journaled) {
+	Vector *vector = journaled->vector;
+	struct stat status;
+	if (fstat(journaled->log_fd, &status) != 0) {
+		fprintf(stderr, "ERROR: Failed to read %s: %s\n", journaled->log_path, strerror(errno));
 		return FALSE;
 	}
 
-	for (int i = 0; i < vector1->length; i++) {
-		void *elem1 = get_elem(vector1, i);
+	size_t size = status.st_size;
+	if (size < sizeof(JournalHeader)) {
+		return journal_reset_log(journaled);
+	}
 
-		for (int j = 0; j < vector2->length; j++) {
-			void *elem2 = get_elem(vector2, j);
+	void *log = mmap(NULL, size, PROT_READ, MAP_PRIVATE, journaled->log_fd, 0);
+	if (log == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Failed to map %s: %s\n", journaled->log_path, strerror(errno));
+		return FALSE;
+	}
 
-			if (memcmp(elem1, elem2, vector1->elem_size) == 0) { // memcmp returns 0 if memory is equal
-				return TRUE;
-			}
+	JournalHeader *header = log;
+	if (memcmp(header->magic, VECTOR_JOURNAL_MAGIC, sizeof(header->magic)) != 0
+			|| header->version != VECTOR_FILE_VERSION || header->endianness != 0x01020304
+			|| header->elem_size != vector->elem_size) {
+		fprintf(stderr, "ERROR: %s is not a compatible vector journal!\n", journaled->log_path);
+		munmap(log, size);
+		return FALSE;
+	}
+	if (header->base_length != vector->length
+			|| header->base_checksum != hash_bytes(vector->array, vector->length * vector->elem_size)) {
+		munmap(log, size);
+		return journal_reset_log(journaled);
+	}
+
+	size_t offset = sizeof(JournalHeader);
+	while (offset + sizeof(JournalRecord) <= size) {
+		// Copied out, since records follow elements of any size and so may be misaligned in the log
+		JournalRecord record;
+		memcpy(&record, log + offset, sizeof(record));
+		size_t elems = journal_record_elems(&record);
+		size_t available = size - offset - sizeof(JournalRecord);
+
+		if (elems > available / vector->elem_size) {
+			break;
+		}
+		void *elements = log + offset + sizeof(JournalRecord);
+		size_t bytes = elems * vector->elem_size;
+		if (journal_checksum(&record, elements, bytes) != record.checksum || !journal_apply(vector, &record, elements)) {
+			break;
 		}
+		offset += sizeof(JournalRecord) + bytes;
 	}
+	munmap(log, size);
 
-	return FALSE;
+	if (offset < size) {
+		fprintf(stderr, "ERROR: %s ends in a torn or corrupt record, dropping its last %zu bytes!\n",
+				journaled->log_path, size - offset);
+		if (ftruncate(journaled->log_fd, offset) != 0) {
+			fprintf(stderr, "ERROR: Failed to truncate %s: %s\n", journaled->log_path, strerror(errno));
+			return FALSE;
+		}
+	}
+
+	journaled->log_bytes = offset;
+	return TRUE;
 }
 
 /**
- * Swaps two elements in a vector from given indexes.
+ * Opens a journaled vector: loads the base snapshot (if there is one), replays the log on top of it,
+ * and carries on logging to it. A torn record at the end of the log (from a crash mid write) is
+ * dropped along with everything after it; records which were committed are never lost.
  *
- * @param vector The vector to perform the swap in
+ * @param base_path The path of the base snapshot, which need not exist yet
+ * @param log_path The path of the log, which need not exist yet
+ * @param elem_size The size of each element in the vector
+ * @param commit_every The amount of records per group commit (1 to commit every operation, 0 to
+ *                     commit only on journal_commit)
+ * @param checkpoint_bytes The log size at which a commit also rolls the log into the base snapshot
+ *                         (0 to only checkpoint on journal_checkpoint)
+ * @return The journaled vector, or NULL if the files could not be opened or are invalid
+ */
+JournaledVector* open_journaled_vector(const char *base_path, const char *log_path, size_t elem_size,
+		size_t commit_every, size_t checkpoint_bytes) {
+	Vector *vector = access(base_path, F_OK) == 0 ? vector_load(base_path) : create_vector(elem_size);
+	if (vector == NULL) {
+		return NULL;
+	}
+	if (vector->elem_size != elem_size) {
+		fprintf(stderr, "ERROR: %s holds elements of size %zu, not %zu!\n", base_path, vector->elem_size, elem_size);
+		free_vector(vector);
+		return NULL;
+	}
+
+	int fd = open(log_path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s: %s\n", log_path, strerror(errno));
+		free_vector(vector);
+		return NULL;
+	}
+
+	JournaledVector *journaled = malloc(sizeof(JournaledVector));
+	journaled->vector = vector;
+	journaled->base_path = strdup(base_path);
+	journaled->log_path = strdup(log_path);
+	journaled->log_fd = fd;
+	journaled->pending = create_vector(sizeof(char));
+	journaled->pending_records = 0;
+	journaled->commit_every = commit_every;
+	journaled->checkpoint_bytes = checkpoint_bytes;
+	journaled->log_bytes = 0;
+
+	if (!journal_replay(journaled)) {
+		free_journaled_vector(journaled);
+		return NULL;
+	}
+	return journaled;
+}
+
+/**
+ * Pushes an element to the back of a journaled vector, and logs it.
+ *
+ * @param journaled The journaled vector
+ * @param element The element to push
+ * @return Whether it was applied (and the log could be written if a commit was due)
+ */
+BOOL journal_push_back(JournaledVector *journaled, void *element) {
+	return journal_record(journaled, JOURNAL_PUSH_BACK, 0, 0, element);
+}
+
+/**
+ * Sets an element of a journaled vector, and logs it.
+ *
+ * @param journaled The journaled vector
+ * @param index The index of the element (0 <= index < length)
+ * @param element The data to set the element to
+ * @return Whether it was applied (FALSE for an index out of range, or if a due commit failed)
+ */
+BOOL journal_set_elem(JournaledVector *journaled, int index, void *element) {
+	return journal_record(journaled, JOURNAL_SET_ELEM, index, 0, element);
+}
+
+/**
+ * Removes an element of a journaled vector (shifting the rest across), and logs it.
+ *
+ * @param journaled The journaled vector
+ * @param index The index of the element (0 <= index < length)
+ * @return Whether it was applied (FALSE for an index out of range, or if a due commit failed)
+ */
+BOOL journal_remove_elem(JournaledVector *journaled, int index) {
+	return journal_record(journaled, JOURNAL_REMOVE_ELEM, index, 0, NULL);
+}
+
+/**
+ * Swaps two elements of a journaled vector, and logs it.
+ *
+ * @param journaled The journaled vector
  * @param index1 The first index
  * @param index2 The second index
+ * @return Whether it was applied (FALSE for an index out of range, or if a due commit failed)
  */
-void swap_elems(Vector *vector, int index1, int index2) {
-	if (index1 == index2) {
-		return;
+BOOL journal_swap_elems(JournaledVector *journaled, int index1, int index2) {
+	return journal_record(journaled, JOURNAL_SWAP_ELEMS, index1, index2, NULL);
+}
+
+/**
+ * Overwrites a range of elements of a journaled vector, and logs it as a single record.
+ *
+ * @param journaled The journaled vector
+ * @param index The first index to overwrite
+ * @param elements The elements to write
+ * @param count The amount of elements (index + count <= length)
+ * @return Whether it was applied (FALSE for a range out of bounds, or if a due commit failed)
+ */
+BOOL journal_set_range(JournaledVector *journaled, size_t index, void *elements, size_t count) {
+	return journal_record(journaled, JOURNAL_SET_RANGE, index, count, elements);
+}
+
+/**
+ * Removes the elements in [from, to) of a journaled vector (shifting the rest across),
+ * and logs it as a single record.
+ *
+ * @param journaled The journaled vector
+ * @param from The first index to remove
+ * @param to One past the last index to remove (from <= to <= length)
+ * @return Whether it was applied (FALSE for a range out of bounds, or if a due commit failed)
+ */
+BOOL journal_remove_range(JournaledVector *journaled, size_t from, size_t to) {
+	return journal_record(journaled, JOURNAL_REMOVE_RANGE, from, to, NULL);
+}
+
+/**
+ * Writes every pending record of a journaled vector to its log with one write, and makes them
+ * durable with one fdatasync. Rolls the log into the base snapshot if it has grown past checkpoint_bytes.
+ * If the commit fails, the log is cut back to the records committed before it.
+ *
+ * @param journaled The journaled vector
+ * @return Whether the records are durable (if not, they stay pending)
+ */
+BOOL journal_commit(JournaledVector *journaled) {
+	if (journaled->pending_records > 0) {
+		// Written from the end of the committed records, over anything a failed commit left behind
+		if (lseek(journaled->log_fd, journaled->log_bytes, SEEK_SET) < 0
+				|| !write_fully(journaled->log_fd, journaled->pending->array, journaled->pending->length)
+				|| fdatasync(journaled->log_fd) != 0) {
+			fprintf(stderr, "ERROR: Failed to write %s: %s\n", journaled->log_path, strerror(errno));
+
+			// Drop whatever part of the group reached the file, so a retry cannot log records twice
+			if (ftruncate(journaled->log_fd, journaled->log_bytes) != 0) {
+				fprintf(stderr, "ERROR: Failed to truncate %s: %s\n", journaled->log_path, strerror(errno));
+			}
+			return FALSE;
+		}
+
+		journaled->log_bytes += journaled->pending->length;
+		journaled->pending->length = 0;
+		journaled->pending_records = 0;
 	}
 
-	void *elem1 = get_elem(vector, index1);
-	void *elem2 = get_elem(vector, index2);
+	if (journaled->checkpoint_bytes > 0 && journaled->log_bytes >= journaled->checkpoint_bytes) {
+		return journal_checkpoint(journaled);
+	}
+	return TRUE;
+}
 
-	void *temp = malloc(vector->elem_size);
-	memcpy(temp, elem1, vector->elem_size);
+/**
+ * Rolls a journaled vector's log into its base snapshot: the vector is saved (to a temporary file,
+ * renamed into place, with the rename made durable) and only then is the log started afresh.
+ * A crash at any point leaves a base and log which open to the same vector.
+ *
+ * @param journaled The journaled vector
+ * @return Whether the checkpoint was taken
+ */
+BOOL journal_checkpoint(JournaledVector *journaled) {
+	size_t path_length = strlen(journaled->base_path);
+	char *temporary = malloc(path_length + sizeof(".tmp"));
+	memcpy(temporary, journaled->base_path, path_length);
+	memcpy(temporary + path_length, ".tmp", sizeof(".tmp"));
 
-	set_elem(vector, index1, elem2);
-	set_elem(vector, index2, temp);
+	int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	BOOL saved = fd >= 0 && vector_write_fd(journaled->vector, fd) && fsync(fd) == 0;
+	if (fd >= 0) {
+		saved = close(fd) == 0 && saved;
+	}
+	saved = saved && rename(temporary, journaled->base_path) == 0;
 
-	free(temp);
+	// The rename must be durable before the log is reset, or a crash could bring back the old base
+	// alongside a log naming the new one (which would be discarded as stale)
+	saved = saved && fsync_parent_directory(journaled->base_path);
+	if (!saved) {
+		fprintf(stderr, "ERROR: Failed to checkpoint %s: %s\n", journaled->base_path, strerror(errno));
+		unlink(temporary);
+	}
+	free(temporary);
+	if (!saved) {
+		return FALSE;
+	}
+
+	// Pending records are in the new base. Once it is in place, the old log no longer matches it
+	// and would be discarded on open anyway
+	journaled->pending->length = 0;
+	journaled->pending_records = 0;
+	return journal_reset_log(journaled);
 }
 
 /**
- * Sorts a vector with a comparison function.
- * Uses selection sort (O(n^2)).
+ * Commits any pending records of a journaled vector and frees it (and its vector).
  *
- * @param vector The vector to sort
- * @param sort  The function pointer to compare two similar elements
- *              (Return 1 if elem1 > elem2, 0 if elem1 == elem2, -1 if elem1 < elem2)
+ * @param journaled The journaled vector
  */
-void sort_vector(Vector *vector, int (*compare)(void *elem1, void *elem2)) {
-	for (int i = 0; i < vector->length - 1; i++) {
-		int min_index = i;
-		void *min = get_elem(vector, i);
+void free_journaled_vector(JournaledVector *journaled) {
+	journal_commit(journaled);
 
-		for (int j = i + 1; j < vector->length; j++) {
-			void *candidate = get_elem(vector, j);
+	close(journaled->log_fd);
+	free_vector(journaled->vector);
+	free_vector(journaled->pending);
+	free(journaled->base_path);
+	free(journaled->log_path);
+	free(journaled);
+}
 
-			int result = compare(min, candidate);
+/**
+ * Whether a character separates numbers in text being imported.
+ *
+ * @param c The character
+ * @return Whether it is a comma or whitespace
+ */
+static BOOL is_text_delimiter(char c) {
+	return c == ',' || c == '\n' || c == ' ' || c == '\r' || c == '\t';
+}
 
-			if (result == 1) {
-				min = candidate;
-				min_index = j;
+/**
+ * Parses an integer (an optional sign and decimal digits) from text.
+ *
+ * @param p The start of the number
+ * @param stop The end of the text
+ * @param type NUMERIC_INT or NUMERIC_LONG
+ * @param out Where to store the number
+ * @return One past the end of the number, or NULL if it is not a valid integer of the type
+ */
+static const char* parse_integer(const char *p, const char *stop, NumericType type, void *out) {
+	BOOL negative = FALSE;
+	if (p < stop && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	const char *digits = p;
+	unsigned long long value = 0;
+	while (p < stop && (unsigned char) (*p - '0') < 10) {
+		unsigned int digit = *p - '0';
+		if (value > (ULLONG_MAX - digit) / 10) {
+			return NULL;
+		}
+		value = value * 10 + digit;
+		p++;
+	}
+
+	unsigned long long limit = type == NUMERIC_INT
+			? (negative ? (unsigned long long) INT_MAX + 1 : INT_MAX)
+			: (negative ? (unsigned long long) LLONG_MAX + 1 : LLONG_MAX);
+	if (p == digits || value > limit) {
+		return NULL;
+	}
+
+	// Negated as value - 1 so the most negative number never overflows
+	long long signed_value = negative && value > 0 ? -(long long) (value - 1) - 1 : (long long) value;
+	if (type == NUMERIC_INT) {
+		*(int*) out = (int) signed_value;
+	} else {
+		*(long long*) out = signed_value;
+	}
+	return p;
+}
+
+/**
+ * Parses a decimal number from text with strtod / strtof, for the numbers parse_real cannot convert
+ * exactly (very long or large numbers, inf and nan).
+ *
+ * @param p The start of the number
+ * @param stop The end of the text
+ * @param type NUMERIC_FLOAT or NUMERIC_DOUBLE
+ * @param out Where to store the number
+ * @return One past the end of the number, or NULL if it is not a valid number
+ */
+static const char* parse_real_slow(const char *p, const char *stop, NumericType type, void *out) {
+	// The text is not NUL terminated, so the number is copied out
+	char token[128];
+	size_t length = 0;
+	while (p + length < stop && !is_text_delimiter(p[length])) {
+		if (length == sizeof(token) - 1) {
+			return NULL;
+		}
+		token[length] = p[length];
+		length++;
+	}
+	token[length] = '\0';
+
+	char *end;
+	if (type == NUMERIC_FLOAT) {
+		*(float*) out = strtof(token, &end);
+	} else {
+		*(double*) out = strtod(token, &end);
+	}
+	return length > 0 && end == token + length ? p + length : NULL;
+}
+
+/**
+ * Parses a decimal number (an optional sign, digits, fraction and exponent) from text.
+ * Numbers with few enough significant digits and a small enough exponent are converted exactly
+ * with a single multiplication or division by a power of 10; the rest go through parse_real_slow.
+ *
+ * @param p The start of the number
+ * @param stop The end of the text
+ * @param type NUMERIC_FLOAT or NUMERIC_DOUBLE
+ * @param out Where to store the number
+ * @return One past the end of the number, or NULL if it is not a valid number
+ */
+static const char* parse_real(const char *p, const char *stop, NumericType type, void *out) {
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const char *start = p;
+
+	BOOL negative = FALSE;
+	if (p < stop && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int significant = 0;
+	int exponent = 0;
+	BOOL any_digits = FALSE;
+	BOOL truncated = FALSE;
+
+	while (p < stop && (unsigned char) (*p - '0') < 10) {
+		if (significant < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			significant += mantissa > 0;
+		} else {
+			exponent++;
+			truncated |= *p != '0';
+		}
+		any_digits = TRUE;
+		p++;
+	}
+	if (p < stop && *p == '.') {
+		p++;
+		while (p < stop && (unsigned char) (*p - '0') < 10) {
+			if (significant < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				significant += mantissa > 0;
+				exponent--;
+			} else {
+				truncated |= *p != '0';
 			}
+			any_digits = TRUE;
+			p++;
+		}
+	}
+	if (!any_digits) {
+		return parse_real_slow(start, stop, type, out);
+	}
+
+	if (p < stop && (*p == 'e' || *p == 'E')) {
+		p++;
+		BOOL negative_exponent = FALSE;
+		if (p < stop && (*p == '-' || *p == '+')) {
+			negative_exponent = *p == '-';
+			p++;
 		}
 
-		swap_elems(vector, i, min_index);
+		const char *digits = p;
+		int written = 0;
+		while (p < stop && (unsigned char) (*p - '0') < 10) {
+			written = MIN(written * 10 + (*p - '0'), 100000);
+			p++;
+		}
+		if (p == digits) {
+			return NULL;
+		}
+		exponent += negative_exponent ? -written : written;
+	}
+
+	// Exact operands and a single rounding step give the correctly rounded result
+	if (!truncated && type == NUMERIC_DOUBLE && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+		double value = exponent < 0 ? mantissa / powers[-exponent] : mantissa * powers[exponent];
+		*(double*) out = negative ? -value : value;
+		return p;
 	}
+	if (!truncated && type == NUMERIC_FLOAT && mantissa <= (1ULL << 24) && exponent >= -10 && exponent <= 10) {
+		float value = exponent < 0 ? (float) mantissa / (float) powers[-exponent] : (float) mantissa * (float) powers[exponent];
+		*(float*) out = negative ? -value : value;
+		return p;
+	}
+	return parse_real_slow(start, stop, type, out);
 }
 
 /**
- * Push an element to the back of the vector.
+ * Parses every number in a chunk of text (the body of each vector_parse_text thread).
  *
- * @param vector The vector
- * @param element The element to insert
+ * @param argument The TextImportChunk
+ * @return NULL
  */
-void push_back(Vector *vector, void *element) {
-	if (vector->length >= vector->capacity) {
-		expand_vector(vector, vector->capacity * 2);
+static void* parse_text_chunk(void *argument) {
+	TextImportChunk *chunk = argument;
+	Vector *parsed = chunk->parsed;
+	BOOL integers = chunk->type == NUMERIC_INT || chunk->type == NUMERIC_LONG;
+	const char *p = chunk->text + chunk->start;
+	const char *stop = chunk->text + chunk->end;
+
+	while (TRUE) {
+		while (p < stop && is_text_delimiter(*p)) {
+			p++;
+		}
+		if (p == stop) {
+			return NULL;
+		}
+
+		if (parsed->length == parsed->capacity) {
+			reserve_vector(parsed, parsed->capacity * 2);
+		}
+		void *slot = parsed->array + parsed->length * parsed->elem_size;
+		const char *next = integers ? parse_integer(p, stop, chunk->type, slot) : parse_real(p, stop, chunk->type, slot);
+
+		if (next == NULL || (next < stop && !is_text_delimiter(*next))) {
+			chunk->error_at = p - chunk->text;
+			return NULL;
+		}
+		parsed->length++;
+		p = next;
 	}
-	set_elem(vector, vector->length, element);
-	vector->length++;
 }
 
 /**
- * Expands a vector to a new capacity (retaining all current data)
+ * Parses numbers separated by commas, newlines and/or other whitespace (eg. CSV of numbers) and appends
+ * them to a numeric vector, all at once. Numbers are converted with custom integer and decimal routines
+ * (falling back on strtod only for the rare numbers those cannot convert exactly), and large texts are
+ * split into chunks parsed in parallel. Vectors in sorted mode have the numbers merged in.
  *
- * @param vector The vector
- * @param new_size The size to expand the vector's capacity to
+ * @param vector The vector, whose elements are of the given type
+ * @param text The text (need not be NUL terminated)
+ * @param length The length of the text
+ * @param type The type of the numbers (integers may not have a fraction or exponent)
+ * @param threads The most threads to parse with (1 parses on the calling thread)
+ * @return Whether the whole text was valid (if not, nothing is appended)
  */
-void expand_vector(Vector *vector, size_t new_size) {
-	void *array = vector->array;
+BOOL vector_parse_text(Vector *vector, const char *text, size_t length, NumericType type, int threads) {
+	if (!check_writable(vector, "vector_parse_text")) {
+		return FALSE;
+	}
+	if (vector->elem_size != numeric_size(type)) {
+		fprintf(stderr, "ERROR: Vector elements are not of the numeric type being parsed!\n");
+		return FALSE;
+	}
 
-	size_t new_bytes = vector->elem_size * new_size;
+	int count = MAX(MIN(MIN(threads, TEXT_IMPORT_MAX_THREADS), (int) (length / TEXT_IMPORT_MIN_CHUNK)), 1);
+	TextImportChunk chunks[TEXT_IMPORT_MAX_THREADS];
+	pthread_t workers[TEXT_IMPORT_MAX_THREADS];
+	BOOL started[TEXT_IMPORT_MAX_THREADS] = { FALSE };
 
-	void *new_array = realloc(array, new_bytes);
+	// Chunks start just after a delimiter, so no number is split between two of them
+	size_t start = 0;
+	for (int i = 0; i < count; i++) {
+		size_t end = i == count - 1 ? length : MAX(length / count * (i + 1), start);
+		while (end < length && !is_text_delimiter(text[end - 1])) {
+			end++;
+		}
 
-	if (new_array == NULL) { // PANIC!
-		fprintf(stderr, "ERROR: Vector expansion failed, possibly out of memory? Exiting...\n");
-		exit(1);
-		return;
+		chunks[i].text = text;
+		chunks[i].start = start;
+		chunks[i].end = end;
+		chunks[i].type = type;
+		chunks[i].parsed = create_vector_with_capacity(vector->elem_size, MAX((end - start) / 8, 1));
+		chunks[i].error_at = SIZE_MAX;
+		start = end;
+
+		if (i > 0) {
+			started[i] = pthread_create(&workers[i], NULL, parse_text_chunk, &chunks[i]) == 0;
+		}
+	}
+	// Chunks whose thread could not be created are parsed here instead
+	for (int i = 0; i < count; i++) {
+		if (!started[i]) {
+			parse_text_chunk(&chunks[i]);
+		}
 	}
 
-	vector->array = new_array;
-	vector->capacity = new_size;
+	size_t error_at = SIZE_MAX;
+	size_t total = 0;
+	for (int i = 0; i < count; i++) {
+		if (started[i]) {
+			pthread_join(workers[i], NULL);
+		}
+		error_at = MIN(error_at, chunks[i].error_at);
+		total += chunks[i].parsed->length;
+	}
+
+	if (error_at != SIZE_MAX) {
+		size_t line = 1;
+		for (size_t i = 0; i < error_at; i++) {
+			line += text[i] == '\n';
+		}
+		fprintf(stderr, "ERROR: Invalid number on line %zu!\n", line);
+	} else if (vector->sorted_by != NULL) {
+		for (int i = 0; i < count; i++) {
+			merge_insert_sorted(vector, chunks[i].parsed, vector->sorted_by);
+		}
+	} else if (!reserve_vector(vector, vector->length + total)) {
+		error_at = 0; // reserve_vector has complained, this only reports the failure
+	} else {
+		size_t old_length = vector->length;
+		for (int i = 0; i < count; i++) {
+			Vector *parsed = chunks[i].parsed;
+			memcpy(vector->array + vector->length * vector->elem_size, parsed->array, parsed->length * parsed->elem_size);
+			vector->length += parsed->length;
+		}
+		vector_modified(vector, old_length, vector->length);
+	}
+
+	for (int i = 0; i < count; i++) {
+		free_vector(chunks[i].parsed);
+	}
+	return error_at == SIZE_MAX;
 }
 
 /**
- * Memory management: Deallocate a vector.
+ * Imports a text file of numbers separated by commas, newlines and/or other whitespace into a numeric
+ * vector (see vector_parse_text). The file is mapped into memory rather than read.
  *
- * @param vector The vector to deallocate
+ * @param vector The vector, whose elements are of the given type
+ * @param path The path of the file
+ * @param type The type of the numbers
+ * @param threads The most threads to parse with (1 parses on the calling thread)
+ * @return Whether the whole file was read and valid (if not, nothing is appended)
  */
-void free_vector(Vector *vector) {
-    free(vector->array);
-    free(vector);
+BOOL vector_import_text(Vector *vector, const char *path, NumericType type, int threads) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Failed to open %s for reading: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0) {
+		fprintf(stderr, "ERROR: Failed to read %s: %s\n", path, strerror(errno));
+		close(fd);
+		return FALSE;
+	}
+	if (status.st_size == 0) {
+		close(fd);
+		return TRUE;
+	}
+
+	void *text = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (text == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Failed to map %s: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+	madvise(text, status.st_size, MADV_SEQUENTIAL);
+
+	BOOL imported = vector_parse_text(vector, text, status.st_size, type, threads);
+	munmap(text, status.st_size);
+	return imported;
 }